@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <string>
+#include <vector>
+
+struct UsageReader
+{
+	UsageReader(MockAmx &amx, int id) : amx(amx), values(amx.buffer(7))
+	{
+		if (id >= 0)
+		{
+			arguments.push_back(id);
+		}
+		for (cell i = 0; i < 7; ++i)
+		{
+			arguments.push_back(values + i * static_cast<cell>(sizeof(cell)));
+		}
+	}
+
+	cell read(const char *native)
+	{
+		return amx.invoke(amx.native(native), arguments);
+	}
+
+	cell operator[](int index)
+	{
+		return amx.address(values)[index];
+	}
+
+	MockAmx &amx;
+	cell values;
+	std::vector<cell> arguments;
+};
+
+// Replacing a value in place moves its bytes between the type counters (a
+// shorter string may keep its buffer, so string bytes are read back rather
+// than assumed), and the store total changes by exactly what the ID reports.
+TEST(accounting_set_replace_delete)
+{
+	MockAmx amx;
+	UsageReader usage(amx, 89), total(amx, -1);
+	std::string key(40, 'k'), value(100, 'v');
+	cell totalBefore = total.read("GetGVarTotalMemoryUsage");
+	CHECK(usage.read("GetGVarMemoryUsage") == 0);
+	amx.invoke(amx.native("SetGVarInt"), amx.string(key), 1, 89);
+	cell bytes = usage.read("GetGVarMemoryUsage");
+	cell entryBytes = usage[4];
+	CHECK(entryBytes > 0 && usage[1] > 40 && usage[2] == 0 && usage[5] == 0 && usage[6] == 0);
+	CHECK(total.read("GetGVarTotalMemoryUsage") - totalBefore == bytes);
+	amx.invoke(amx.native("SetGVarString"), amx.string(key), amx.string(value), 89);
+	usage.read("GetGVarMemoryUsage");
+	CHECK(usage[2] > 100 && usage[4] == 0 && usage[5] == entryBytes + usage[2]);
+	amx.invoke(amx.native("SetGVarString"), amx.string(key), amx.string("x"), 89);
+	usage.read("GetGVarMemoryUsage");
+	CHECK(usage[4] == 0 && usage[5] == entryBytes + usage[2]);
+	amx.invoke(amx.native("SetGVarFloat"), amx.string("other"), 0, 89);
+	usage.read("GetGVarMemoryUsage");
+	CHECK(usage[5] == entryBytes + usage[2] && usage[6] == entryBytes);
+	amx.invoke(amx.native("DeleteGVar"), amx.string(key), 89);
+	bytes = usage.read("GetGVarMemoryUsage");
+	CHECK(usage[1] == 0 && usage[2] == 0 && usage[4] == 0 && usage[5] == 0 && usage[6] == entryBytes);
+	CHECK(total.read("GetGVarTotalMemoryUsage") - totalBefore == bytes);
+	amx.invoke(amx.native("DeleteGVars"), 89);
+	CHECK(usage.read("GetGVarMemoryUsage") == 0);
+	CHECK(total.read("GetGVarTotalMemoryUsage") == totalBefore);
+	amx.release();
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+
+static int connectAdmin(const std::string &path)
+{
+	int client = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::strcpy(address.sun_path, path.c_str());
+	if (connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+	{
+		close(client);
+		return -1;
+	}
+	return client;
+}
+
+// Sends a command and runs ticks until the blank line that ends the reply.
+static std::string query(int client, const std::string &command)
+{
+	std::string line = command + "\n", reply;
+	send(client, line.data(), line.length(), MSG_NOSIGNAL);
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (std::chrono::steady_clock::now() < deadline && (reply.length() < 2 || reply.compare(reply.length() - 2, 2, "\n\n")))
+	{
+		ProcessTick();
+		pollfd descriptor = { client, POLLIN, 0 };
+		if (poll(&descriptor, 1, 10) > 0)
+		{
+			char data[4096];
+			ssize_t length = recv(client, data, sizeof(data), 0);
+			if (length <= 0)
+			{
+				break;
+			}
+			reply.append(data, static_cast<std::size_t>(length));
+		}
+	}
+	return reply;
+}
+
+TEST(admin_escaping)
+{
+	MockAmx amx;
+	AMX_NATIVE open = amx.native("OpenGVarAdminSocket"), close = amx.native("CloseGVarAdminSocket"), setString = amx.native("SetGVarString"),
+		getString = amx.native("GetGVarString");
+	std::string path = "/tmp/gvar-test-admin-" + std::to_string(getpid());
+	CHECK(amx.invoke(open, amx.string(path)) == 1);
+	amx.invoke(setString, amx.string("multi"), amx.string("one\ntwo\\three"), 0);
+	amx.release();
+	int client = connectAdmin(path);
+	CHECK(client >= 0);
+	CHECK(query(client, "get 0 multi") == "string one\\ntwo\\\\three\n\n");
+	CHECK(query(client, "set 0 copy a\\nb") == "queued\n\n");
+	ProcessTick();
+	cell buffer = amx.buffer(16);
+	amx.invoke(getString, std::vector<cell>{ amx.string("copy"), buffer, 16, 0 });
+	CHECK(amx.read(buffer) == "a\nb");
+	::close(client);
+	amx.release();
+	amx.invoke(close, std::vector<cell>());
+}
+
+// A client that disconnects while a large dump is being written must not take
+// the process down with SIGPIPE, and the endpoint must serve the next client.
+TEST(admin_disconnect_during_dump)
+{
+	MockAmx amx(1 << 22);
+	AMX_NATIVE open = amx.native("OpenGVarAdminSocket"), close = amx.native("CloseGVarAdminSocket"), setString = amx.native("SetGVarString");
+	std::string path = "/tmp/gvar-test-admin-" + std::to_string(getpid());
+	CHECK(amx.invoke(open, amx.string(path)) == 1);
+	for (int i = 0; i < 20000; ++i)
+	{
+		amx.invoke(setString, amx.string("entry" + std::to_string(i)), amx.string(std::string(100, 'x')), 77);
+		amx.release();
+	}
+	int client = connectAdmin(path);
+	std::string line = "dump 77\n";
+	send(client, line.data(), line.length(), MSG_NOSIGNAL);
+	for (int i = 0; i < 20; ++i)
+	{
+		ProcessTick();
+		usleep(5000);
+	}
+	char data[64];
+	recv(client, data, sizeof(data), 0);
+	::close(client);
+	client = connectAdmin(path);
+	CHECK(client >= 0);
+	CHECK(query(client, "get 77 entry19999") == "string " + std::string(100, 'x') + "\n\n");
+	::close(client);
+	amx.invoke(close, std::vector<cell>());
+	amx.release();
+}
+
+TEST(admin_per_id_requests)
+{
+	MockAmx amx;
+	AMX_NATIVE open = amx.native("OpenGVarAdminSocket"), close = amx.native("CloseGVarAdminSocket"), setInt = amx.native("SetGVarInt");
+	std::string path = "/tmp/gvar-test-admin-" + std::to_string(getpid());
+	CHECK(amx.invoke(open, amx.string(path)) == 1);
+	amx.invoke(setInt, amx.string("first"), 1, 78);
+	amx.invoke(setInt, amx.string("second"), 2, 79);
+	amx.release();
+	int client = connectAdmin(path);
+	CHECK(client >= 0);
+	CHECK(query(client, "get 78 first") == "int 1\n\n");
+	CHECK(query(client, "get 78 second") == "none\n\n");
+	CHECK(query(client, "list 79") == "0 second\n\n");
+	CHECK(query(client, "dump 79") == "{\"id\":79,\"index\":0,\"name\":\"second\",\"type\":\"int\",\"value\":2}\n\n");
+	std::string dump = query(client, "dump");
+	CHECK(dump.find("\"id\":78,\"index\":0,\"name\":\"first\"") != std::string::npos);
+	CHECK(dump.find("\"id\":79,\"index\":0,\"name\":\"second\"") != std::string::npos);
+	::close(client);
+	amx.invoke(amx.native("DeleteGVars"), 78);
+	amx.invoke(amx.native("DeleteGVars"), 79);
+	amx.invoke(close, std::vector<cell>());
+	amx.release();
+}
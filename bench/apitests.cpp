@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "main.h"
+#include "reclaimer.h"
+#include "tests.h"
+
+#include <gvar/api.h>
+
+#include <string>
+
+PLUGIN_EXPORT const gvar_api *PLUGIN_CALL GVar_GetApi();
+
+// A handle caches the location of its GVar. Deleting the GVar bumps
+// storeVersion, so the handle must look it up again instead of reading the
+// freed entry, and it must find the GVar once it is set again.
+TEST(api_handle_invalidation)
+{
+	const gvar_api *api = GVar_GetApi();
+	gvar_handle handle = api->resolve(73, "Cached");
+	int32_t value = 0;
+	CHECK(api->get_int(handle, &value) == 0);
+	CHECK(api->set_int(handle, 1) == 1);
+	CHECK(api->get_int(handle, &value) == 1 && value == 1);
+	unsigned int version = storeVersion;
+	deleteGVar(73, "cached");
+	CHECK(storeVersion != version);
+	CHECK(api->get_int(handle, &value) == 0);
+	CHECK(api->get_type(handle) == GVAR_TYPE_NONE);
+	setGVar(73, "cached", 2.5f);
+	float real = 0.0f;
+	CHECK(api->get_int(handle, &value) == 0);
+	CHECK(api->get_float(handle, &real) == 1 && real == 2.5f);
+	CHECK(api->set_int(handle, 3) == 1);
+	CHECK(api->get_int(handle, &value) == 1 && value == 3);
+	api->release(handle);
+	deleteGVars(73);
+}
+
+// Overwriting a large string in place hands the old buffer to the reclaimer
+// instead of freeing it on the server thread.
+TEST(api_set_defers_large_strings)
+{
+	const gvar_api *api = GVar_GetApi();
+	gvar_handle handle = api->resolve(73, "text");
+	std::string first(300, 'a'), second(600, 'b');
+	CHECK(api->set_string(handle, first.c_str(), first.length()) == 1);
+	ProcessTick();
+	CHECK(!reclaimPending);
+	CHECK(api->set_string(handle, second.c_str(), second.length()) == 1);
+	CHECK(reclaimPending);
+	char buffer[8];
+	CHECK(api->get_string(handle, buffer, sizeof(buffer)) == 600 && std::string(buffer) == "bbbbbbb");
+	ProcessTick();
+	api->release(handle);
+	deleteGVars(73);
+}
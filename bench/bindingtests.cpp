@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "mockamx.h"
+#include "tests.h"
+
+#define BINDING_TEST_GLOBALS (64)
+
+// Only whole cells in the data section below the heap can be bound, and a
+// bound global follows every write to its GVar until it is unbound.
+TEST(binding_address_bounds)
+{
+	MockAmx amx(1 << 16, BINDING_TEST_GLOBALS);
+	AMX_NATIVE bind = amx.native("BindGVarInt"), unbind = amx.native("UnbindGVarInt"), setInt = amx.native("SetGVarInt");
+	cell first = amx.global(0), last = amx.global(BINDING_TEST_GLOBALS - 1), name = amx.string("bound");
+	amx.invoke(setInt, name, 7, 76);
+	CHECK(amx.invoke(bind, name, 76, first) == 1);
+	CHECK(amx.invoke(bind, name, 76, first) == 0);
+	CHECK(amx.invoke(bind, name, 76, last) == 1);
+	CHECK(*amx.address(first) == 7 && *amx.address(last) == 7);
+	CHECK(amx.invoke(bind, name, 76, -static_cast<cell>(sizeof(cell))) == 0);
+	CHECK(amx.invoke(bind, name, 76, amx.global(BINDING_TEST_GLOBALS)) == 0);
+	CHECK(amx.invoke(bind, name, 76, last + 2) == 0);
+	CHECK(amx.invoke(bind, name, 76, first + 1) == 0);
+	CHECK(amx.invoke(bind, name, 76, amx.buffer(1)) == 0);
+	amx.invoke(setInt, name, 8, 76);
+	CHECK(*amx.address(first) == 8 && *amx.address(last) == 8);
+	CHECK(amx.invoke(unbind, name, 76, last) == 1);
+	amx.invoke(setInt, name, 9, 76);
+	CHECK(*amx.address(first) == 9 && *amx.address(last) == 8);
+	amx.invoke(amx.native("DeleteGVars"), 76);
+	CHECK(*amx.address(first) == 0);
+	CHECK(amx.invoke(unbind, name, 76, first) == 1);
+	amx.release();
+}
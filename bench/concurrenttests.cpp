@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "concurrent.h"
+#include "main.h"
+#include "tests.h"
+
+#include <gvar/api.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+PLUGIN_EXPORT const gvar_api *PLUGIN_CALL GVar_GetApi();
+
+// Shards grow while another thread keeps writing and reading, so keys written
+// during a grow must reach the new table.
+TEST(concurrent_grow)
+{
+	enableConcurrentReads();
+	const int keys = 50000;
+	int missing = 0;
+	std::thread writer([&missing]()
+	{
+		for (int i = 0; i < keys; ++i)
+		{
+			std::string name = "off" + std::to_string(i);
+			Value value = i;
+			writeConcurrent(70, name, hashConcurrent(70, name), &value);
+			Value read;
+			if (!readConcurrent(70, name, hashConcurrent(70, name), read) || boost::get<int>(read) != i)
+			{
+				++missing;
+			}
+		}
+	});
+	for (int i = 0; i < keys; ++i)
+	{
+		setGVar(71, "main" + std::to_string(i), i);
+		if (i % 1000 == 0)
+		{
+			processConcurrent();
+		}
+	}
+	writer.join();
+	processConcurrent();
+	CHECK(missing == 0);
+	int wrong = 0;
+	for (int i = 0; i < keys; ++i)
+	{
+		std::string off = "off" + std::to_string(i), main = "main" + std::to_string(i);
+		Value read;
+		if (!readConcurrent(70, off, hashConcurrent(70, off), read) || boost::get<int>(read) != i)
+		{
+			++wrong;
+		}
+		if (!readConcurrent(71, main, hashConcurrent(71, main), read) || boost::get<int>(read) != i)
+		{
+			++wrong;
+		}
+	}
+	CHECK(wrong == 0);
+	CHECK(mainMap[70]->size() == static_cast<std::size_t>(keys));
+	deleteGVars(70);
+	deleteGVars(71);
+	disableConcurrentReads();
+}
+
+// The replica stays until every enabler has disabled it. A write queued from
+// another thread just before the last disable still reaches mainMap, and a
+// reader that keeps running sees the replica disappear instead of crashing.
+TEST(concurrent_disable_refcount)
+{
+	const gvar_api *api = GVar_GetApi();
+	CHECK(api->version >= 4);
+	gvar_handle handle = api->resolve(72, "Shared");
+	CHECK(api->enable_concurrent_reads() == 1);
+	CHECK(api->enable_concurrent_reads() == 1);
+	std::atomic<bool> reading(true);
+	std::thread reader([&]()
+	{
+		gvar_handle own = api->resolve(72, "shared");
+		int32_t value = 0;
+		while (reading)
+		{
+			api->concurrent_get_int(own, &value);
+		}
+		api->release(own);
+	});
+	CHECK(api->concurrent_set_int(handle, 5) == 1);
+	CHECK(api->concurrent_disable() == 1);
+	CHECK(concurrentReads);
+	int32_t value = 0;
+	CHECK(api->concurrent_get_int(handle, &value) == 1 && value == 5);
+	CHECK(api->concurrent_set_int(handle, 6) == 1);
+	CHECK(api->concurrent_disable() == 1);
+	CHECK(!concurrentReads);
+	reading = false;
+	reader.join();
+	CHECK(api->concurrent_get_int(handle, &value) == 0);
+	CHECK(api->concurrent_set_int(handle, 7) == 0);
+	CHECK(api->get_int(handle, &value) == 1 && value == 6);
+	CHECK(api->concurrent_disable() == 0);
+	api->release(handle);
+	deleteGVars(72);
+}
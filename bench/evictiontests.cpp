@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "concurrent.h"
+#include "eviction.h"
+#include "main.h"
+#include "tests.h"
+
+#include <string>
+
+static bool hasGVar(int id, const std::string &name)
+{
+	MainMap::const_iterator i = mainMap.find(id);
+	return i != mainMap.end() && i->second->find(name) != i->second->end();
+}
+
+// The hand passes a referenced GVar once, clearing its flag, and evicts the
+// first GVar that was not read since the last sweep.
+TEST(eviction_clock)
+{
+	CHECK(setCacheLimit(NULL, 50, 50, 3, 0, false));
+	setGVar(50, "a", 1);
+	setGVar(50, "b", 2);
+	setGVar(50, "c", 3);
+	touchCache(50, "a");
+	setGVar(50, "d", 4);
+	CHECK(hasGVar(50, "a"));
+	CHECK(!hasGVar(50, "b"));
+	CHECK(hasGVar(50, "c"));
+	CHECK(hasGVar(50, "d"));
+	setGVar(50, "e", 5);
+	CHECK(!hasGVar(50, "c"));
+	CHECK(hasGVar(50, "a"));
+	CHECK(mainMap[50]->size() == 3);
+	setCacheLimit(NULL, 50, 50, 0, 0, false);
+	deleteGVars(50);
+}
+
+// A queued off-thread write that pushes an ID over its limit evicts other
+// GVars, and the replica must forget them too.
+TEST(eviction_updates_replica)
+{
+	enableConcurrentReads();
+	CHECK(setCacheLimit(NULL, 51, 51, 2, 0, false));
+	setGVar(51, "x", 1);
+	setGVar(51, "y", 2);
+	Value value = 3;
+	CHECK(writeConcurrent(51, "z", hashConcurrent(51, "z"), &value));
+	processConcurrent();
+	CHECK(!hasGVar(51, "x"));
+	CHECK(hasGVar(51, "z"));
+	Value read;
+	CHECK(!readConcurrent(51, "x", hashConcurrent(51, "x"), read));
+	CHECK(readConcurrent(51, "z", hashConcurrent(51, "z"), read) && boost::get<int>(read) == 3);
+	setCacheLimit(NULL, 51, 51, 0, 0, false);
+	deleteGVars(51);
+	disableConcurrentReads();
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "expiry.h"
+#include "main.h"
+#include "mockamx.h"
+#include "tests.h"
+
+#include <gvar/api.h>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+PLUGIN_EXPORT const gvar_api *PLUGIN_CALL GVar_GetApi();
+
+static bool hasGVar(int id, const std::string &name)
+{
+	MainMap::const_iterator i = mainMap.find(id);
+	return i != mainMap.end() && i->second->find(name) != i->second->end();
+}
+
+static int countEntries(void *userdata, const gvar_entry *entry)
+{
+	++*static_cast<int*>(userdata);
+	return 0;
+}
+
+// Timers on the first three wheel levels never fire before their TTL has
+// elapsed and fire within a few ticks after it.
+TEST(expiry_wheel)
+{
+	const int ttls[] = { 1, 30, 63, 64, 200, 4100 };
+	const int count = sizeof(ttls) / sizeof(ttls[0]);
+	double expired[count] = { 0.0 };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < count; ++i)
+	{
+		setGVar(60, "timer" + std::to_string(i), i);
+		setExpiry(60, "timer" + std::to_string(i), ttls[i]);
+	}
+	for (int remaining = count; remaining; )
+	{
+		processExpiry();
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		remaining = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			if (hasGVar(60, "timer" + std::to_string(i)))
+			{
+				++remaining;
+			}
+			else if (expired[i] == 0.0)
+			{
+				expired[i] = elapsed;
+			}
+		}
+		usleep(500);
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		CHECK(expired[i] >= ttls[i]);
+		CHECK(expired[i] <= ttls[i] + 50);
+	}
+	CHECK(!expiryActive);
+}
+
+// Writing a GVar again moves or clears its timer.
+TEST(expiry_rewrite)
+{
+	setGVar(61, "moved", 1);
+	setExpiry(61, "moved", 10);
+	setExpiry(61, "moved", 100000);
+	setGVar(61, "cleared", 1);
+	setExpiry(61, "cleared", 10);
+	clearExpiry(61, "cleared");
+	usleep(20000);
+	processExpiry();
+	CHECK(hasGVar(61, "moved"));
+	CHECK(hasGVar(61, "cleared"));
+	CHECK(getExpiry(61, "moved") > 99000);
+	CHECK(getExpiry(61, "cleared") == -1);
+	deleteGVars(61);
+	CHECK(!expiryActive);
+}
+
+// An expired GVar reads as missing through enumeration and the C API even
+// when no tick has run since its TTL elapsed.
+TEST(expiry_reads_missing)
+{
+	MockAmx amx;
+	AMX_NATIVE setIntEx = amx.native("SetGVarIntEx"), nameAtIndex = amx.native("GetGVarNameAtIndex");
+	CHECK(amx.invoke(setIntEx, std::vector<cell>{ amx.string("short"), 1, 62, 5 }) == 1);
+	const gvar_api *api = GVar_GetApi();
+	gvar_handle handle = api->resolve(62, "SHORT");
+	int32_t value = 0;
+	CHECK(api->get_int(handle, &value) && value == 1);
+	usleep(20000);
+	cell buffer = amx.buffer(32);
+	CHECK(amx.invoke(nameAtIndex, std::vector<cell>{ 0, buffer, 32, 62 }) == 0);
+	CHECK(amx.invoke(setIntEx, std::vector<cell>{ amx.string("again"), 2, 62, 5 }) == 1);
+	usleep(20000);
+	CHECK(!api->get_int(handle, &value));
+	int entries = 0;
+	api->iterate(62, countEntries, &entries);
+	CHECK(entries == 0);
+	CHECK(!hasGVar(62, "again"));
+	api->release(handle);
+	amx.release();
+}
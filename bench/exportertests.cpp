@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "exporter.h"
+#include "main.h"
+#include "mockamx.h"
+#include "tests.h"
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+
+static std::set<std::string> readLines(const std::string &path)
+{
+	std::set<std::string> lines;
+	std::ifstream file(path.c_str());
+	std::string line;
+	while (std::getline(file, line))
+	{
+		lines.insert(line);
+	}
+	return lines;
+}
+
+TEST(exporter_roundtrip)
+{
+	MockAmx amx;
+	AMX_NATIVE exportGVars = amx.native("ExportGVars"), setInt = amx.native("SetGVarInt"),
+		setFloat = amx.native("SetGVarFloat"), setString = amx.native("SetGVarString");
+	float ratio = 0.5f;
+	amx.invoke(setInt, amx.string("count"), -7, 101);
+	amx.invoke(setFloat, amx.string("ratio"), amx_ftoc(ratio), 101);
+	amx.invoke(setString, amx.string("text"), amx.string("a\"b\\c\n\t\x01\xe9"), 101);
+	amx.invoke(setInt, amx.string("other"), 1, 102);
+	CHECK(amx.invoke(exportGVars, amx.string("gvar-test-export.jsonl"), 101) == 1);
+	CHECK(amx.invoke(exportGVars, amx.string("gvar-test-export.jsonl"), 101) == 0);
+	waitForExport();
+	std::set<std::string> lines = readLines("scriptfiles/gvar-test-export.jsonl");
+	CHECK(lines.size() == 3);
+	CHECK(lines.count("{\"id\":101,\"index\":0,\"name\":\"count\",\"type\":\"int\",\"value\":-7}"));
+	CHECK(lines.count("{\"id\":101,\"index\":1,\"name\":\"ratio\",\"type\":\"float\",\"value\":0.5}"));
+	CHECK(lines.count("{\"id\":101,\"index\":2,\"name\":\"text\",\"type\":\"string\",\"value\":\"a\\\"b\\\\c\\n\\t\\u0001\\u00e9\"}"));
+	CHECK(!std::ifstream("scriptfiles/gvar-test-export.jsonl.tmp"));
+	CHECK(amx.invoke(exportGVars, amx.string("../gvar-test-export.jsonl"), 101) == 0);
+	CHECK(amx.invoke(exportGVars, amx.string("/tmp/gvar-test-export.jsonl"), 101) == 0);
+	amx.invoke(amx.native("DeleteGVars"), 101);
+	amx.invoke(amx.native("DeleteGVars"), 102);
+	amx.release();
+}
+
+// Growing the ID after the first batch rehashes its table, so the export has
+// to start that ID over without writing any GVar twice.
+TEST(exporter_rehash_during_export)
+{
+	MockAmx amx;
+	AMX_NATIVE exportGVars = amx.native("ExportGVars"), setInt = amx.native("SetGVarInt");
+	for (int i = 0; i < 10000; ++i)
+	{
+		amx.invoke(setInt, amx.string("old" + std::to_string(i)), i, 103);
+		amx.release();
+	}
+	CHECK(amx.invoke(exportGVars, amx.string("gvar-test-rehash.jsonl"), 103) == 1);
+	ProcessTick();
+	for (int i = 0; i < 50000; ++i)
+	{
+		amx.invoke(setInt, amx.string("new" + std::to_string(i)), i, 103);
+		amx.release();
+	}
+	waitForExport();
+	std::map<std::string, int> names;
+	std::ifstream file("scriptfiles/gvar-test-rehash.jsonl");
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::string::size_type begin = line.find("\"name\":\"") + 8;
+		++names[line.substr(begin, line.find('"', begin) - begin)];
+	}
+	int old = 0, duplicates = 0;
+	for (std::map<std::string, int>::const_iterator n = names.begin(); n != names.end(); ++n)
+	{
+		old += n->first.compare(0, 3, "old") == 0;
+		duplicates += n->second > 1;
+	}
+	CHECK(old == 10000);
+	CHECK(duplicates == 0);
+	amx.invoke(amx.native("DeleteGVars"), 103);
+	amx.release();
+}
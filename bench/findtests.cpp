@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Runs FindGVarsAsync and ticks until its callback has delivered the names.
+static std::string findNames(MockAmx &amx, const std::string &pattern)
+{
+	AMX_NATIVE find = amx.native("FindGVarsAsync"), result = amx.native("GetGVarAsyncResult");
+	std::vector<std::string> names;
+	bool delivered = false;
+	cell idBuffer = amx.buffer(1), nameBuffer = amx.buffer(32);
+	amx.publics.clear();
+	amx.addPublic("OnFound", [&](const std::vector<cell> &arguments) -> cell
+	{
+		for (cell i = 0; i < arguments[1]; ++i)
+		{
+			if (amx.invoke(result, i, idBuffer, nameBuffer, 32))
+			{
+				names.push_back(amx.read(nameBuffer));
+			}
+		}
+		delivered = true;
+		return 1;
+	});
+	if (!amx.invoke(find, 97, amx.string(pattern), amx.string("OnFound"), 0))
+	{
+		return "(not queued)";
+	}
+	for (int i = 0; i < 1000 && !delivered; ++i)
+	{
+		ProcessTick();
+		usleep(1000);
+	}
+	amx.release();
+	std::sort(names.begin(), names.end());
+	std::string joined;
+	for (std::vector<std::string>::const_iterator n = names.begin(); n != names.end(); ++n)
+	{
+		joined += (joined.empty() ? "" : ",") + *n;
+	}
+	return delivered ? joined : "(no callback)";
+}
+
+TEST(find_patterns)
+{
+	MockAmx amx;
+	AMX_NATIVE setInt = amx.native("SetGVarInt");
+	const char *names[] = { "apple", "apricot", "banana", "grape", "a" };
+	for (std::size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+	{
+		amx.invoke(setInt, amx.string(names[i]), 1, 97);
+	}
+	amx.release();
+	CHECK(findNames(amx, "ap*") == "apple,apricot");
+	CHECK(findNames(amx, "*an*") == "banana");
+	CHECK(findNames(amx, "?") == "a");
+	CHECK(findNames(amx, "*") == "a,apple,apricot,banana,grape");
+	CHECK(findNames(amx, "*E") == "apple,grape");
+	CHECK(findNames(amx, "a*p*e") == "apple");
+	CHECK(findNames(amx, "gr?pe") == "grape");
+	CHECK(findNames(amx, "**ple") == "apple");
+	CHECK(findNames(amx, "ap") == "");
+	CHECK(findNames(amx, "") == "");
+	amx.invoke(amx.native("DeleteGVars"), 97);
+}
+
+// The first tick copies part of the ID, then the ID grows enough to be rehashed.
+// The copy has to start that ID over, so no GVar is sorted twice.
+TEST(sort_copies_in_batches)
+{
+	MockAmx amx;
+	AMX_NATIVE setInt = amx.native("SetGVarInt"), sort = amx.native("SortGVarsAsync"), result = amx.native("GetGVarAsyncResult");
+	for (int i = 0; i < 10000; ++i)
+	{
+		amx.invoke(setInt, amx.string("old" + std::to_string(i)), i, 98);
+		amx.release();
+	}
+	std::vector<std::string> names;
+	cell idBuffer = amx.buffer(1), nameBuffer = amx.buffer(32);
+	amx.publics.clear();
+	amx.addPublic("OnSorted", [&](const std::vector<cell> &arguments) -> cell
+	{
+		for (cell i = 0; i < arguments[1]; ++i)
+		{
+			if (amx.invoke(result, i, idBuffer, nameBuffer, 32))
+			{
+				names.push_back(amx.read(nameBuffer));
+			}
+		}
+		return 1;
+	});
+	CHECK(amx.invoke(sort, 98, amx.string("OnSorted"), 1, 3) != 0);
+	ProcessTick();
+	for (int i = 0; i < 50000; ++i)
+	{
+		amx.invoke(setInt, amx.string("new" + std::to_string(i)), -1, 98);
+		amx.release();
+	}
+	for (int i = 0; i < 1000 && names.empty(); ++i)
+	{
+		ProcessTick();
+		usleep(1000);
+	}
+	CHECK(names.size() == 3);
+	CHECK(names.size() == 3 && names[0] == "old9999" && names[1] == "old9998" && names[2] == "old9997");
+	amx.invoke(amx.native("DeleteGVars"), 98);
+	amx.release();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "main.h"
+#include "mockamx.h"
+#include "tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The reported counts must match a walk over the table's buckets, and
+// deleted GVars must show up as free indexes.
+TEST(health_counts)
+{
+	MockAmx amx;
+	AMX_NATIVE health = amx.native("GetGVarHealth"), setInt = amx.native("SetGVarInt");
+	for (int i = 0; i < 200; ++i)
+	{
+		amx.invoke(setInt, amx.string("health" + std::to_string(i)), i, 94);
+	}
+	amx.invoke(amx.native("DeleteGVar"), amx.string("health7"), 94);
+	amx.invoke(amx.native("DeleteGVar"), amx.string("health8"), 94);
+	const DataMap &data = *mainMap[94];
+	std::size_t usedBuckets = 0, maxChain = 0, probes = 0;
+	for (std::size_t b = 0; b < data.bucket_count(); ++b)
+	{
+		std::size_t chain = data.bucket_size(b);
+		usedBuckets += chain ? 1 : 0;
+		maxChain = std::max(maxChain, chain);
+		probes += chain * (chain + 1) / 2;
+	}
+	cell values = amx.buffer(6);
+	cell *counts = amx.address(values);
+	std::vector<cell> arguments(1, 94);
+	for (cell i = 0; i < 6; ++i)
+	{
+		arguments.push_back(values + i * static_cast<cell>(sizeof(cell)));
+	}
+	CHECK(amx.invoke(health, arguments) == 1);
+	CHECK(counts[0] == 198);
+	CHECK(counts[1] == static_cast<cell>(data.bucket_count()));
+	CHECK(counts[2] == static_cast<cell>(maxChain));
+	CHECK(std::fabs(amx_ctof(counts[3]) - static_cast<float>(probes) / 198) < 0.001f);
+	CHECK(counts[4] == 2);
+	CHECK(counts[5] == static_cast<cell>(198 - usedBuckets));
+	arguments[0] = 99;
+	CHECK(amx.invoke(health, arguments) == 0);
+	amx.invoke(amx.native("DeleteGVars"), 94);
+	amx.release();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "loader.h"
+#include "main.h"
+#include "mockamx.h"
+#include "tests.h"
+
+#include <fstream>
+#include <string>
+
+#define LOADER_TEST_KEYS (80000)
+
+// Large enough for four workers, so the second and fourth chunks start without
+// a section header and have to inherit the one from the chunk before them.
+TEST(loader_sections_across_chunks)
+{
+	MockAmx amx;
+	AMX_NATIVE load = amx.native("LoadGVarsFromFile"), getInt = amx.native("GetGVarInt");
+	{
+		std::ofstream file("scriptfiles/gvar-test-sections.ini");
+		file << "top = -1\n[Alpha]\n";
+		for (int i = 0; i < LOADER_TEST_KEYS; ++i)
+		{
+			if (i == LOADER_TEST_KEYS / 2)
+			{
+				file << "[Beta]\n";
+			}
+			file << "key" << i << " = " << i << "\n";
+		}
+	}
+	loaderThreads = 4;
+	CHECK(amx.invoke(load, amx.string("gvar-test-sections.ini"), 100, GLOBAL_VARFORMAT_INI) == LOADER_TEST_KEYS + 1);
+	loaderThreads = 0;
+	CHECK(amx.invoke(getInt, amx.string("top"), 100) == -1);
+	CHECK(amx.invoke(getInt, amx.string("alpha.key0"), 100) == 0);
+	CHECK(amx.invoke(getInt, amx.string("alpha.key30000"), 100) == 30000);
+	CHECK(amx.invoke(getInt, amx.string("alpha.key39999"), 100) == 39999);
+	CHECK(amx.invoke(getInt, amx.string("beta.key40000"), 100) == 40000);
+	CHECK(amx.invoke(getInt, amx.string("beta.key70000"), 100) == 70000);
+	CHECK(amx.invoke(getInt, amx.string("key30000"), 100) == 0);
+	amx.invoke(amx.native("DeleteGVars"), 100);
+	amx.release();
+}
+
+TEST(loader_rejects_paths_outside_scriptfiles)
+{
+	CHECK(!isScriptFilePath("../gvar-test.ini"));
+	CHECK(!isScriptFilePath("data/../../gvar-test.ini"));
+	CHECK(!isScriptFilePath("data\\..\\..\\gvar-test.ini"));
+	CHECK(!isScriptFilePath("/etc/passwd"));
+	CHECK(!isScriptFilePath("\\gvar-test.ini"));
+	CHECK(!isScriptFilePath("C:gvar-test.ini"));
+	CHECK(!isScriptFilePath(""));
+	CHECK(isScriptFilePath("data/gvar-test.ini"));
+	CHECK(isScriptFilePath("gvar..test.ini"));
+	MockAmx amx;
+	CHECK(amx.invoke(amx.native("LoadGVarsFromFile"), amx.string("../gvar-test.ini"), 100, GLOBAL_VARFORMAT_AUTO) == 0);
+	amx.release();
+}
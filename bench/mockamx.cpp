@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+
+#include <sdk/plugin.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData);
+PLUGIN_EXPORT void PLUGIN_CALL Unload();
+PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx);
+PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx);
+
+static void *exports[PLUGIN_AMX_EXPORT_UTF8Put + 1];
+static void *pluginData[PLUGIN_DATA_CALLPUBLIC_GM + 1];
+
+static MockAmx *mockOf(AMX *amx)
+{
+	return static_cast<MockAmx*>(amx->userdata[0]);
+}
+
+static void mockLogprintf(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vfprintf(stderr, format, args);
+	va_end(args);
+	std::fputc('\n', stderr);
+}
+
+static int AMXAPI mockGetAddr(AMX *amx, cell amxAddress, cell **physicalAddress)
+{
+	if (amxAddress < 0 || amxAddress >= amx->stp || amxAddress % sizeof(cell))
+	{
+		*physicalAddress = NULL;
+		return AMX_ERR_MEMACCESS;
+	}
+	*physicalAddress = reinterpret_cast<cell*>(amx->data + amxAddress);
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockStrLen(const cell *string, int *length)
+{
+	int count = 0;
+	if (static_cast<ucell>(*string) > UNPACKEDMAX)
+	{
+		for (const cell *c = string; ; ++c)
+		{
+			ucell value = static_cast<ucell>(*c);
+			if (!(value & 0xFF000000)) break;
+			++count;
+			if (!(value & 0x00FF0000)) break;
+			++count;
+			if (!(value & 0x0000FF00)) break;
+			++count;
+			if (!(value & 0x000000FF)) break;
+			++count;
+		}
+	}
+	else
+	{
+		while (string[count])
+		{
+			++count;
+		}
+	}
+	*length = count;
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockGetString(char *dest, const cell *source, int useWchar, size_t size)
+{
+	size_t i = 0;
+	if (static_cast<ucell>(*source) > UNPACKEDMAX)
+	{
+		for (; i + 1 < size; ++i)
+		{
+			char c = static_cast<char>(static_cast<ucell>(source[i / sizeof(cell)]) >> ((sizeof(cell) - 1 - i % sizeof(cell)) * 8));
+			if (!c)
+			{
+				break;
+			}
+			dest[i] = c;
+		}
+	}
+	else
+	{
+		for (; i + 1 < size && source[i]; ++i)
+		{
+			dest[i] = static_cast<char>(source[i]);
+		}
+	}
+	if (size)
+	{
+		dest[i] = '\0';
+	}
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockSetString(cell *dest, const char *source, int pack, int useWchar, size_t size)
+{
+	size_t length = std::strlen(source);
+	if (pack)
+	{
+		if (length >= size * sizeof(cell))
+		{
+			length = size * sizeof(cell) - 1;
+		}
+		std::memset(dest, 0, (length / sizeof(cell) + 1) * sizeof(cell));
+		for (size_t i = 0; i < length; ++i)
+		{
+			dest[i / sizeof(cell)] |= static_cast<cell>(static_cast<ucell>(static_cast<unsigned char>(source[i])) << ((sizeof(cell) - 1 - i % sizeof(cell)) * 8));
+		}
+	}
+	else
+	{
+		if (length >= size)
+		{
+			length = size - 1;
+		}
+		for (size_t i = 0; i < length; ++i)
+		{
+			dest[i] = static_cast<cell>(source[i]);
+		}
+		dest[length] = 0;
+	}
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockAllot(AMX *amx, int cells, cell *amxAddress, cell **physicalAddress)
+{
+	if (amx->hea + static_cast<cell>(cells * sizeof(cell)) > amx->stk)
+	{
+		return AMX_ERR_MEMORY;
+	}
+	*amxAddress = amx->hea;
+	*physicalAddress = reinterpret_cast<cell*>(amx->data + amx->hea);
+	amx->hea += cells * sizeof(cell);
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockRelease(AMX *amx, cell amxAddress)
+{
+	if (amxAddress >= amx->hlw && amxAddress < amx->hea)
+	{
+		amx->hea = amxAddress;
+	}
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockRegister(AMX *amx, const AMX_NATIVE_INFO *list, int number)
+{
+	for (int i = 0; (number < 0 || i < number) && list[i].name; ++i)
+	{
+		mockOf(amx)->natives[list[i].name] = list[i].func;
+	}
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockFindPublic(AMX *amx, const char *name, int *index)
+{
+	MockAmx *mock = mockOf(amx);
+	for (std::size_t i = 0; i < mock->publics.size(); ++i)
+	{
+		if (mock->publics[i].first == name)
+		{
+			*index = static_cast<int>(i);
+			return AMX_ERR_NONE;
+		}
+	}
+	return AMX_ERR_NOTFOUND;
+}
+
+static int AMXAPI mockPush(AMX *amx, cell value)
+{
+	mockOf(amx)->pushed.push_back(value);
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockExec(AMX *amx, cell *result, int index)
+{
+	MockAmx *mock = mockOf(amx);
+	if (index < 0 || index >= static_cast<int>(mock->publics.size()))
+	{
+		return AMX_ERR_INDEX;
+	}
+	std::vector<cell> arguments(mock->pushed.rbegin(), mock->pushed.rend());
+	mock->pushed.clear();
+	cell value = mock->publics[index].second(arguments);
+	if (result)
+	{
+		*result = value;
+	}
+	return AMX_ERR_NONE;
+}
+
+static int AMXAPI mockRaiseError(AMX *amx, int error)
+{
+	amx->error = error;
+	return AMX_ERR_NONE;
+}
+
+MockAmx::MockAmx(std::size_t cells, std::size_t globals) : memory(cells, 0)
+{
+	std::memset(&amx, 0, sizeof(amx));
+	std::memset(params, 0, sizeof(params));
+	amx.data = reinterpret_cast<unsigned char*>(&memory[0]);
+	amx.hlw = amx.hea = static_cast<cell>(globals * sizeof(cell));
+	amx.stk = amx.stp = static_cast<cell>(cells * sizeof(cell));
+	amx.userdata[0] = this;
+	AmxLoad(&amx);
+}
+
+MockAmx::~MockAmx()
+{
+	AmxUnload(&amx);
+}
+
+AMX *MockAmx::get()
+{
+	return &amx;
+}
+
+AMX_NATIVE MockAmx::native(const std::string &name) const
+{
+	std::map<std::string, AMX_NATIVE>::const_iterator n = natives.find(name);
+	if (n == natives.end())
+	{
+		std::fprintf(stderr, "Native %s is not registered\n", name.c_str());
+		return NULL;
+	}
+	return n->second;
+}
+
+cell *MockAmx::address(cell amxAddress)
+{
+	return reinterpret_cast<cell*>(amx.data + amxAddress);
+}
+
+cell MockAmx::global(std::size_t index) const
+{
+	return static_cast<cell>(index * sizeof(cell));
+}
+
+cell MockAmx::string(const std::string &value)
+{
+	cell amxAddress = buffer(value.length() + 1);
+	mockSetString(address(amxAddress), value.c_str(), 0, 0, value.length() + 1);
+	return amxAddress;
+}
+
+cell MockAmx::buffer(std::size_t cells)
+{
+	cell amxAddress = 0, *physicalAddress = NULL;
+	if (mockAllot(&amx, static_cast<int>(cells), &amxAddress, &physicalAddress) != AMX_ERR_NONE)
+	{
+		std::fprintf(stderr, "Mock AMX heap exhausted\n");
+		return 0;
+	}
+	return amxAddress;
+}
+
+std::string MockAmx::read(cell amxAddress)
+{
+	int length = 0;
+	mockStrLen(address(amxAddress), &length);
+	std::vector<char> string(length + 1);
+	mockGetString(&string[0], address(amxAddress), 0, string.size());
+	return std::string(&string[0], length);
+}
+
+void MockAmx::release()
+{
+	amx.hea = amx.hlw;
+}
+
+cell MockAmx::invoke(AMX_NATIVE native, cell a)
+{
+	params[0] = 1 * sizeof(cell);
+	params[1] = a;
+	return native(&amx, params);
+}
+
+cell MockAmx::invoke(AMX_NATIVE native, cell a, cell b)
+{
+	params[0] = 2 * sizeof(cell);
+	params[1] = a;
+	params[2] = b;
+	return native(&amx, params);
+}
+
+cell MockAmx::invoke(AMX_NATIVE native, cell a, cell b, cell c)
+{
+	params[0] = 3 * sizeof(cell);
+	params[1] = a;
+	params[2] = b;
+	params[3] = c;
+	return native(&amx, params);
+}
+
+cell MockAmx::invoke(AMX_NATIVE native, cell a, cell b, cell c, cell d)
+{
+	params[0] = 4 * sizeof(cell);
+	params[1] = a;
+	params[2] = b;
+	params[3] = c;
+	params[4] = d;
+	return native(&amx, params);
+}
+
+cell MockAmx::invoke(AMX_NATIVE native, const std::vector<cell> &arguments)
+{
+	params[0] = static_cast<cell>(arguments.size() * sizeof(cell));
+	for (std::size_t i = 0; i < arguments.size() && i < 15; ++i)
+	{
+		params[i + 1] = arguments[i];
+	}
+	return native(&amx, params);
+}
+
+void MockAmx::addPublic(const std::string &name, Public function)
+{
+	publics.push_back(std::make_pair(name, function));
+}
+
+void startMockHost()
+{
+	exports[PLUGIN_AMX_EXPORT_Allot] = reinterpret_cast<void*>(mockAllot);
+	exports[PLUGIN_AMX_EXPORT_Exec] = reinterpret_cast<void*>(mockExec);
+	exports[PLUGIN_AMX_EXPORT_FindPublic] = reinterpret_cast<void*>(mockFindPublic);
+	exports[PLUGIN_AMX_EXPORT_GetAddr] = reinterpret_cast<void*>(mockGetAddr);
+	exports[PLUGIN_AMX_EXPORT_GetString] = reinterpret_cast<void*>(mockGetString);
+	exports[PLUGIN_AMX_EXPORT_Push] = reinterpret_cast<void*>(mockPush);
+	exports[PLUGIN_AMX_EXPORT_RaiseError] = reinterpret_cast<void*>(mockRaiseError);
+	exports[PLUGIN_AMX_EXPORT_Register] = reinterpret_cast<void*>(mockRegister);
+	exports[PLUGIN_AMX_EXPORT_Release] = reinterpret_cast<void*>(mockRelease);
+	exports[PLUGIN_AMX_EXPORT_SetString] = reinterpret_cast<void*>(mockSetString);
+	exports[PLUGIN_AMX_EXPORT_StrLen] = reinterpret_cast<void*>(mockStrLen);
+	pluginData[PLUGIN_DATA_LOGPRINTF] = reinterpret_cast<void*>(mockLogprintf);
+	pluginData[PLUGIN_DATA_AMX_EXPORTS] = exports;
+	Load(pluginData);
+}
+
+void stopMockHost()
+{
+	Unload();
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOCKAMX_H
+#define MOCKAMX_H
+
+#include <sdk/plugin.h>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal in-process stand-in for the SA-MP server: a flat AMX data segment
+// with a heap, and an export table covering the amx_* functions the plugin
+// calls. Natives are reached through AmxLoad and amx_Register exactly as in
+// the server, so the real natives[] array is exercised.
+class MockAmx
+{
+public:
+	typedef std::function<cell(const std::vector<cell>&)> Public;
+
+	explicit MockAmx(std::size_t cells = 1 << 20, std::size_t globals = 4096);
+	~MockAmx();
+
+	AMX *get();
+	AMX_NATIVE native(const std::string &name) const;
+	cell *address(cell amxAddress);
+	cell global(std::size_t index) const;
+	cell string(const std::string &value);
+	cell buffer(std::size_t cells);
+	std::string read(cell amxAddress);
+	void release();
+
+	cell invoke(AMX_NATIVE native, cell a);
+	cell invoke(AMX_NATIVE native, cell a, cell b);
+	cell invoke(AMX_NATIVE native, cell a, cell b, cell c);
+	cell invoke(AMX_NATIVE native, cell a, cell b, cell c, cell d);
+	cell invoke(AMX_NATIVE native, const std::vector<cell> &arguments);
+
+	void addPublic(const std::string &name, Public function);
+
+	std::map<std::string, AMX_NATIVE> natives;
+	std::vector<std::pair<std::string, Public> > publics;
+	std::vector<cell> pushed;
+private:
+	AMX amx;
+	std::vector<cell> memory;
+	cell params[16];
+};
+
+void startMockHost();
+void stopMockHost();
+
+#endif
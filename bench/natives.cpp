@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Drives the plugin's natives through a mock AMX host and reports ops/sec and
+// latency percentiles per native. Names are drawn from typical gamemode keys,
+// IDs are skewed towards a small set of busy players, and lookups miss at a
+// configurable rate. A linked property list, as used by the setproperty and
+// getproperty natives in amxcore, is measured through the same call path as
+// a baseline.
+//
+// Usage: gvar-bench [calls per native] [ids] [names per id] [hit percent]
+
+#include "mockamx.h"
+
+#include <sdk/plugin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+struct Options
+{
+	std::size_t calls;
+	int ids;
+	int names;
+	int hitPercent;
+};
+
+struct Call
+{
+	cell name;
+	cell id;
+};
+
+struct Property
+{
+	cell id;
+	std::string name;
+	cell value;
+};
+
+static const char *prefixes[] =
+{
+	"score", "money", "admin_level", "vip", "last_login_ip", "clan_tag", "kills", "deaths",
+	"spawn_x", "spawn_y", "spawn_z", "vehicle_fuel", "mute_time", "jail_time", "faction_rank", "weapon_skill"
+};
+
+static std::list<Property> properties;
+
+static cell AMX_NATIVE_CALL n_setproperty(AMX *amx, cell *params)
+{
+	char *name = NULL;
+	amx_StrParam(amx, params[2], name);
+	for (std::list<Property>::iterator p = properties.begin(); p != properties.end(); ++p)
+	{
+		if (p->id == params[1] && p->name == name)
+		{
+			p->value = params[3];
+			return 1;
+		}
+	}
+	Property property = { params[1], name, params[3] };
+	properties.push_back(property);
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_getproperty(AMX *amx, cell *params)
+{
+	char *name = NULL;
+	amx_StrParam(amx, params[2], name);
+	for (std::list<Property>::iterator p = properties.begin(); p != properties.end(); ++p)
+	{
+		if (p->id == params[1] && p->name == name)
+		{
+			return p->value;
+		}
+	}
+	return 0;
+}
+
+static std::uint32_t nextRandom(std::uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static std::string makeName(int index)
+{
+	char name[64];
+	std::snprintf(name, sizeof(name), "%s_%d", prefixes[index % (sizeof(prefixes) / sizeof(prefixes[0]))], index / static_cast<int>(sizeof(prefixes) / sizeof(prefixes[0])));
+	return name;
+}
+
+static std::vector<Call> makeCalls(const Options &options, const std::vector<cell> &hits, const std::vector<cell> &misses)
+{
+	std::vector<Call> calls(options.calls);
+	std::uint32_t state = 88172645u;
+	for (std::size_t i = 0; i < calls.size(); ++i)
+	{
+		std::uint32_t r = nextRandom(state);
+		// Four in five calls go to the busiest fifth of the IDs.
+		int busy = std::max(1, options.ids / 5);
+		calls[i].id = (r & 0xFF) < 205 ? static_cast<cell>((r >> 8) % busy) : static_cast<cell>((r >> 8) % options.ids);
+		r = nextRandom(state);
+		bool hit = static_cast<int>(r % 100) < options.hitPercent;
+		const std::vector<cell> &names = hit ? hits : misses;
+		calls[i].name = names[(r >> 8) % names.size()];
+	}
+	return calls;
+}
+
+static void report(const char *operation, const std::vector<Call> &calls, const std::function<void(const Call&)> &function)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (std::vector<Call>::const_iterator c = calls.begin(); c != calls.end(); ++c)
+	{
+		function(*c);
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::vector<double> latencies;
+	latencies.reserve(calls.size());
+	for (std::vector<Call>::const_iterator c = calls.begin(); c != calls.end(); ++c)
+	{
+		std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+		function(*c);
+		latencies.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count());
+	}
+	std::sort(latencies.begin(), latencies.end());
+	std::size_t last = latencies.size() - 1;
+	std::printf("%-24s %14.0f %9.0f %9.0f %9.0f %9.0f %9.0f\n", operation, calls.size() / elapsed, latencies[last / 2], latencies[last * 90 / 100], latencies[last * 99 / 100], latencies[last * 999 / 1000], latencies[last]);
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	options.calls = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1000000;
+	options.ids = argc > 2 ? std::max(1, std::atoi(argv[2])) : 500;
+	options.names = argc > 3 ? std::max(1, std::atoi(argv[3])) : 32;
+	options.hitPercent = argc > 4 ? std::min(100, std::max(0, std::atoi(argv[4]))) : 90;
+	startMockHost();
+	{
+		MockAmx amx(1 << 22);
+		std::vector<cell> hits, misses;
+		for (int i = 0; i < options.names; ++i)
+		{
+			hits.push_back(amx.string(makeName(i)));
+			misses.push_back(amx.string("missing_" + makeName(i)));
+		}
+		cell value = amx.string("The quick brown fox jumps over"), buffer = amx.buffer(128);
+		AMX_NATIVE setInt = amx.native("SetGVarInt"), getInt = amx.native("GetGVarInt");
+		AMX_NATIVE setString = amx.native("SetGVarString"), getString = amx.native("GetGVarString");
+		AMX_NATIVE setFloat = amx.native("SetGVarFloat"), getFloat = amx.native("GetGVarFloat");
+		AMX_NATIVE increment = amx.native("IncrementGVarInt"), remove = amx.native("DeleteGVar");
+		AMX_NATIVE getType = amx.native("GetGVarType");
+		amx.natives["setproperty"] = n_setproperty;
+		amx.natives["getproperty"] = n_getproperty;
+		AMX_NATIVE setProperty = amx.native("setproperty"), getProperty = amx.native("getproperty");
+		for (int id = 0; id < options.ids; ++id)
+		{
+			for (std::vector<cell>::iterator n = hits.begin(); n != hits.end(); ++n)
+			{
+				amx.invoke(setInt, *n, id, id);
+				amx.invoke(setProperty, id, *n, id);
+			}
+		}
+		Options all = options;
+		all.hitPercent = 100;
+		std::vector<Call> calls = makeCalls(options, hits, misses), writes = makeCalls(all, hits, misses);
+		std::printf("%zu calls per native, %d IDs, %d names per ID, %d%% hits\n\n", options.calls, options.ids, options.names, options.hitPercent);
+		std::printf("%-24s %14s %9s %9s %9s %9s %9s\n", "native", "ops/s", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+		report("SetGVarInt", writes, [&](const Call &c) { amx.invoke(setInt, c.name, c.id, c.id); });
+		report("GetGVarInt", calls, [&](const Call &c) { amx.invoke(getInt, c.name, c.id); });
+		report("IncrementGVarInt", writes, [&](const Call &c) { amx.invoke(increment, c.name, 1, c.id); });
+		report("GetGVarType", calls, [&](const Call &c) { amx.invoke(getType, c.name, c.id); });
+		report("SetGVarFloat", writes, [&](const Call &c) { float f = static_cast<float>(c.id); amx.invoke(setFloat, c.name, amx_ftoc(f), c.id); });
+		report("GetGVarFloat", calls, [&](const Call &c) { amx.invoke(getFloat, c.name, c.id); });
+		report("SetGVarString", writes, [&](const Call &c) { amx.invoke(setString, c.name, value, c.id); });
+		report("GetGVarString", calls, [&](const Call &c) { amx.invoke(getString, c.name, buffer, 128, c.id); });
+		report("DeleteGVar + SetGVarInt", writes, [&](const Call &c) { amx.invoke(remove, c.name, c.id); amx.invoke(setInt, c.name, 0, c.id); });
+		std::vector<Call> propertyCalls(calls.begin(), calls.begin() + std::min<std::size_t>(calls.size(), 20000));
+		std::vector<Call> propertyWrites(writes.begin(), writes.begin() + std::min<std::size_t>(writes.size(), 20000));
+		report("setproperty (list)", propertyWrites, [&](const Call &c) { amx.invoke(setProperty, c.id, c.name, c.id); });
+		report("getproperty (list)", propertyCalls, [&](const Call &c) { amx.invoke(getProperty, c.id, c.name); });
+	}
+	stopMockHost();
+	return 0;
+}
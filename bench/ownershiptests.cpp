@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "main.h"
+#include "mockamx.h"
+#include "tests.h"
+
+#include <memory>
+
+// Only GVars that an opted-in script creates are owned by it. Overwriting a
+// GVar does not claim it, and a GVar deleted and created again by another
+// script no longer belongs to the first one. Owned GVars in any ID are deleted
+// when the owner is unloaded, even after it has opted out again.
+TEST(ownership_claims)
+{
+	MockAmx other;
+	AMX_NATIVE setInt = other.native("SetGVarInt"), remove = other.native("DeleteGVar"), type = other.native("GetGVarType");
+	std::unique_ptr<MockAmx> owner(new MockAmx);
+	CHECK(owner->invoke(owner->native("EnableGVarOwnership"), 1) == 1);
+	other.invoke(setInt, other.string("existing"), 1, 74);
+	owner->invoke(setInt, owner->string("owned"), 1, 74);
+	owner->invoke(setInt, owner->string("existing"), 2, 74);
+	owner->invoke(setInt, owner->string("recreated"), 1, 74);
+	other.invoke(setInt, other.string("owned"), 2, 74);
+	other.invoke(remove, other.string("recreated"), 74);
+	other.invoke(setInt, other.string("recreated"), 2, 74);
+	owner->invoke(setInt, owner->string("otherid"), 1, 75);
+	CHECK(owner->invoke(owner->native("EnableGVarOwnership"), 0) == 1);
+	owner->invoke(setInt, owner->string("later"), 1, 74);
+	owner.reset();
+	CHECK(other.invoke(type, other.string("owned"), 74) == GLOBAL_VARTYPE_NONE);
+	CHECK(other.invoke(type, other.string("existing"), 74) == GLOBAL_VARTYPE_INT);
+	CHECK(other.invoke(type, other.string("recreated"), 74) == GLOBAL_VARTYPE_INT);
+	CHECK(other.invoke(type, other.string("otherid"), 75) == GLOBAL_VARTYPE_NONE);
+	CHECK(other.invoke(type, other.string("later"), 74) == GLOBAL_VARTYPE_INT);
+	other.invoke(other.native("DeleteGVars"), 74);
+	other.invoke(other.native("DeleteGVars"), 75);
+	other.release();
+}
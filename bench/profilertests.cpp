@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profiler.h"
+#include "tests.h"
+
+#include <string>
+
+// Count-Min estimates never fall below the true count, so with every call
+// sampled the two hottest keys rank first even after many cold keys have
+// cycled through the heap.
+TEST(profiler_heavy_hitters)
+{
+	CHECK(startProfiler(1, 1));
+	for (int i = 0; i < 5000; ++i)
+	{
+		profileAccess(1, "hot", false);
+		if (i < 3000)
+		{
+			profileAccess(2, "warm", false);
+		}
+		if (i < 2000)
+		{
+			profileAccess(3, "cold" + std::to_string(i), false);
+		}
+	}
+	profileAccess(1, "hot", true);
+	int id = 0;
+	std::string name;
+	unsigned long long count = 0;
+	CHECK(getHotKey(0, false, id, name, count) && id == 1 && name == "hot" && count >= 5000 && count < 5100);
+	CHECK(getHotKey(1, false, id, name, count) && id == 2 && name == "warm" && count >= 3000 && count < 3100);
+	CHECK(getHotKey(0, true, id, name, count) && id == 1 && name == "hot" && count == 1);
+	CHECK(!getHotKey(1, true, id, name, count));
+	CHECK(!getHotKey(64, false, id, name, count));
+	stopProfiler();
+}
+
+// IDs are grouped into ranges that start at multiples of the range size,
+// including negative IDs.
+TEST(profiler_id_ranges)
+{
+	CHECK(startProfiler(1, 100));
+	profileAccess(105, "player", true);
+	profileAccess(150, "player", true);
+	profileAccess(199, "player", true);
+	profileAccess(-1, "player", true);
+	int id = 0;
+	std::string name;
+	unsigned long long count = 0;
+	CHECK(getHotKey(0, true, id, name, count) && id == 100 && count == 3);
+	CHECK(getHotKey(1, true, id, name, count) && id == -100 && count == 1);
+	stopProfiler();
+}
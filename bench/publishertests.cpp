@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <gvar/shm.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#define PUBLISHER_TEST_WRITES (200000)
+
+// A string slot read through the seqlock must come from a single write: the
+// writer only stores runs of one character, so a torn copy shows up as mixed
+// characters or a length that does not match the terminator.
+static bool consistent(const gvar_shm_slot &slot)
+{
+	if (slot.type != GVAR_SHM_TYPE_STRING)
+	{
+		return slot.type == GVAR_SHM_TYPE_NONE || slot.type == GVAR_SHM_TYPE_INT;
+	}
+	if (slot.length <= 0 || slot.length >= GVAR_SHM_STRING_SIZE || static_cast<int32_t>(strnlen(slot.string, GVAR_SHM_STRING_SIZE)) != slot.length)
+	{
+		return false;
+	}
+	for (int32_t i = 1; i < slot.length; ++i)
+	{
+		if (slot.string[i] != slot.string[0])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static int readUntilClosed(const std::string &name)
+{
+	int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+	if (descriptor < 0)
+	{
+		return 2;
+	}
+	std::size_t size = sizeof(gvar_shm_header) + sizeof(gvar_shm_slot);
+	void *address = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (address == MAP_FAILED)
+	{
+		return 2;
+	}
+	const gvar_shm_header *header = static_cast<const gvar_shm_header*>(address);
+	unsigned long long reads = 0, torn = 0;
+	while (true)
+	{
+		gvar_shm_slot slot;
+		gvar_shm_read_slot(gvar_shm_get_slot(header, 0), &slot);
+		++reads;
+		if (!consistent(slot))
+		{
+			++torn;
+		}
+		if (slot.type == GVAR_SHM_TYPE_INT)
+		{
+			break;
+		}
+	}
+	munmap(address, size);
+	return torn ? 1 : 0;
+}
+
+TEST(publisher_seqlock)
+{
+	MockAmx amx;
+	AMX_NATIVE openMemory = amx.native("OpenGVarSharedMemory"), closeMemory = amx.native("CloseGVarSharedMemory"), publish = amx.native("PublishGVar"),
+		setString = amx.native("SetGVarString"), setInt = amx.native("SetGVarInt");
+	std::string name = "/gvar-test-" + std::to_string(getpid());
+	amx.invoke(setString, amx.string("value"), amx.string("a"), 0);
+	CHECK(amx.invoke(openMemory, amx.string(name), 1) == 1);
+	CHECK(amx.invoke(publish, amx.string("value"), 0) == 1);
+	amx.release();
+	pid_t reader = fork();
+	if (!reader)
+	{
+		_exit(readUntilClosed(name));
+	}
+	cell nameAddress = amx.string("value");
+	for (int i = 0; i < PUBLISHER_TEST_WRITES; ++i)
+	{
+		cell value = amx.string(std::string(1 + i % (GVAR_SHM_STRING_SIZE - 1), static_cast<char>('a' + i % 26)));
+		amx.invoke(setString, nameAddress, value, 0);
+		amx.release();
+		nameAddress = amx.string("value");
+	}
+	amx.invoke(setInt, nameAddress, 1, 0);
+	int status = 0;
+	waitpid(reader, &status, 0);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	amx.release();
+	amx.invoke(closeMemory, std::vector<cell>());
+}
+
+TEST(publisher_limits)
+{
+	MockAmx amx;
+	AMX_NATIVE openMemory = amx.native("OpenGVarSharedMemory"), closeMemory = amx.native("CloseGVarSharedMemory"), publish = amx.native("PublishGVar");
+	std::string name = "/gvar-test-" + std::to_string(getpid());
+	CHECK(amx.invoke(openMemory, amx.string(name), 1) == 1);
+	CHECK(amx.invoke(publish, amx.string(std::string(GVAR_SHM_NAME_SIZE, 'x')), 0) == 0);
+	CHECK(amx.invoke(publish, amx.string(std::string(GVAR_SHM_NAME_SIZE - 1, 'x')), 0) == 1);
+	CHECK(amx.invoke(publish, amx.string(std::string(GVAR_SHM_NAME_SIZE - 1, 'x')), 0) == 1);
+	CHECK(amx.invoke(publish, amx.string("other"), 0) == 0);
+	amx.release();
+	amx.invoke(closeMemory, std::vector<cell>());
+}
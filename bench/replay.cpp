@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a trace recorded with StartGVarTrace against the plugin through the
+// mock AMX host, as fast as possible and in the recorded order, then reports
+// throughput, per-native latency and the peak resident set size.
+//
+// Usage: gvar-replay <trace file> [repeat count]
+
+#include "mockamx.h"
+#include "trace.h"
+
+#include <sdk/plugin.h>
+
+#include <boost/unordered_map.hpp>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define REPLAY_BUCKETS (32)
+
+struct Call
+{
+	AMX_NATIVE native;
+	int index;
+	std::vector<cell> arguments;
+};
+
+struct Statistics
+{
+	Statistics() : calls(0), nanoseconds(0.0)
+	{
+		std::fill(buckets, buckets + REPLAY_BUCKETS, 0);
+	}
+
+	unsigned long long calls;
+	double nanoseconds;
+	unsigned long long buckets[REPLAY_BUCKETS];
+};
+
+static long peakMemory()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static int bucketOf(double nanoseconds)
+{
+	int bucket = 0;
+	for (unsigned long long value = static_cast<unsigned long long>(nanoseconds); value > 1 && bucket < REPLAY_BUCKETS - 1; value >>= 1)
+	{
+		++bucket;
+	}
+	return bucket;
+}
+
+static double percentile(const Statistics &statistics, double fraction)
+{
+	unsigned long long target = static_cast<unsigned long long>(statistics.calls * fraction), seen = 0;
+	for (int i = 0; i < REPLAY_BUCKETS; ++i)
+	{
+		seen += statistics.buckets[i];
+		if (seen > target)
+		{
+			return static_cast<double>(2ULL << i);
+		}
+	}
+	return static_cast<double>(2ULL << (REPLAY_BUCKETS - 1));
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "Usage: %s <trace file> [repeat count]\n", argv[0]);
+		return 1;
+	}
+	int repeat = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1;
+	TraceReader reader(argv[1]);
+	if (!reader.valid())
+	{
+		std::fprintf(stderr, "%s is not a GVar trace\n", argv[1]);
+		return 1;
+	}
+	std::vector<TraceRecord> records;
+	TraceRecord record;
+	unsigned long long traced = 0;
+	while (reader.next(record))
+	{
+		if (record.native < 0 || record.native >= TRACE_NATIVES)
+		{
+			std::fprintf(stderr, "Unknown native %d in trace, stopping at record %zu\n", record.native, records.size());
+			break;
+		}
+		traced += record.delta;
+		records.push_back(record);
+	}
+	startMockHost();
+	long baseMemory = peakMemory();
+	{
+		MockAmx amx(1 << 24);
+		AMX_NATIVE natives[TRACE_NATIVES];
+		for (int i = 0; i < TRACE_NATIVES; ++i)
+		{
+			natives[i] = amx.native(traceNativeNames[i]);
+		}
+		boost::unordered_map<std::string, cell> names;
+		boost::unordered_map<int, cell> strings;
+		int capacity = 1;
+		for (std::vector<TraceRecord>::iterator r = records.begin(); r != records.end(); ++r)
+		{
+			switch (r->native)
+			{
+				case TRACE_GETGVARSTRING:
+				case TRACE_GETGVARSTRINGPACKED:
+				case TRACE_GETGVARSTRINGSUB:
+					capacity = std::max(capacity, r->value + 1);
+					break;
+				case TRACE_GETGVARNAMEATINDEX:
+					capacity = std::max(capacity, r->extra);
+					break;
+			}
+		}
+		capacity = std::min(capacity, 1 << 20);
+		cell buffer = amx.buffer(capacity);
+		std::vector<Call> calls;
+		calls.reserve(records.size());
+		for (std::vector<TraceRecord>::iterator r = records.begin(); r != records.end(); ++r)
+		{
+			boost::unordered_map<std::string, cell>::iterator n = names.find(r->name);
+			if (n == names.end())
+			{
+				n = names.insert(std::make_pair(r->name, amx.string(r->name))).first;
+			}
+			cell name = n->second, string = 0;
+			if (r->type == GLOBAL_VARTYPE_STRING)
+			{
+				int length = std::max(0, std::min(r->value, 1 << 16));
+				boost::unordered_map<int, cell>::iterator s = strings.find(length);
+				if (s == strings.end())
+				{
+					s = strings.insert(std::make_pair(length, amx.string(std::string(length, 'x')))).first;
+				}
+				string = s->second;
+			}
+			Call call;
+			call.native = natives[r->native];
+			call.index = r->native;
+			switch (r->native)
+			{
+				case TRACE_SETGVARINT:
+				case TRACE_SETGVARFLOAT:
+				case TRACE_INCREMENTGVARINT:
+					call.arguments = { name, r->value, r->id };
+					break;
+				case TRACE_GETGVARINT:
+				case TRACE_GETGVARFLOAT:
+				case TRACE_DELETEGVAR:
+				case TRACE_GETGVARTYPE:
+				case TRACE_GETGVARSTRINGLENGTH:
+					call.arguments = { name, r->id };
+					break;
+				case TRACE_SETGVARSTRING:
+				case TRACE_APPENDGVARSTRING:
+					call.arguments = { name, string, r->id };
+					break;
+				case TRACE_GETGVARSTRING:
+				case TRACE_GETGVARSTRINGPACKED:
+					call.arguments = { name, buffer, std::min(r->value, capacity), r->id };
+					break;
+				case TRACE_DELETEGVARS:
+				case TRACE_GETGVARSUPPERINDEX:
+					call.arguments = { r->id };
+					break;
+				case TRACE_GETGVARNAMEATINDEX:
+					call.arguments = { r->value, buffer, std::min(r->extra, capacity), r->id };
+					break;
+				case TRACE_GETGVARSTRINGSUB:
+					call.arguments = { name, r->extra, r->value, buffer, capacity, r->id };
+					break;
+				case TRACE_COMPAREGVARSTRING:
+					call.arguments = { name, string, r->extra, r->id };
+					break;
+				case TRACE_APPENDGVARSTRINGCAPPED:
+					call.arguments = { name, string, r->extra, r->id };
+					break;
+				case TRACE_SETGVARINTEX:
+				case TRACE_SETGVARFLOATEX:
+					call.arguments = { name, r->value, r->id, r->extra };
+					break;
+				case TRACE_SETGVARSTRINGEX:
+					call.arguments = { name, string, r->id, r->extra };
+					break;
+				case TRACE_SETGVARTTL:
+					call.arguments = { name, r->id, r->value };
+					break;
+				case TRACE_GETGVARTTL:
+					call.arguments = { name, r->id };
+					break;
+			}
+			calls.push_back(call);
+		}
+		Statistics total, perNative[TRACE_NATIVES];
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < repeat; ++i)
+		{
+			for (std::vector<Call>::iterator c = calls.begin(); c != calls.end(); ++c)
+			{
+				std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+				amx.invoke(c->native, c->arguments);
+				double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+				int bucket = bucketOf(nanoseconds);
+				Statistics &statistics = perNative[c->index];
+				++statistics.calls;
+				statistics.nanoseconds += nanoseconds;
+				++statistics.buckets[bucket];
+				++total.calls;
+				total.nanoseconds += nanoseconds;
+				++total.buckets[bucket];
+			}
+		}
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::printf("%zu records, %zu names, %.3f s traced, replayed %d time(s) in %.3f s (%.0f calls/s)\n", records.size(), names.size(), traced / 1e6, repeat, elapsed, total.calls / elapsed);
+		std::printf("Peak resident set size: %ld KB (%ld KB before replay)\n\n", peakMemory(), baseMemory);
+		std::printf("%-24s %12s %10s %10s %10s\n", "native", "calls", "mean ns", "p50 ns <", "p99 ns <");
+		for (int i = 0; i < TRACE_NATIVES; ++i)
+		{
+			if (perNative[i].calls)
+			{
+				std::printf("%-24s %12llu %10.0f %10.0f %10.0f\n", traceNativeNames[i], perNative[i].calls, perNative[i].nanoseconds / perNative[i].calls, percentile(perNative[i], 0.5), percentile(perNative[i], 0.99));
+			}
+		}
+		std::printf("\nLatency histogram (all natives)\n");
+		for (int i = 0; i < REPLAY_BUCKETS; ++i)
+		{
+			if (total.buckets[i])
+			{
+				double share = 100.0 * total.buckets[i] / total.calls;
+				std::printf("  < %10llu ns %12llu %6.2f%% %s\n", 2ULL << i, total.buckets[i], share, std::string(static_cast<std::size_t>(share / 2), '#').c_str());
+			}
+		}
+	}
+	stopMockHost();
+	return 0;
+}
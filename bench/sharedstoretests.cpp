@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define SHARED_TEST_LOW_ID (1000)
+#define SHARED_TEST_HIGH_ID (1999)
+
+// The segment layout is private to the plugin; these tests only rely on the
+// header fields they need and on every slot starting with its sequence and
+// owner words, which is how another process would find a lock to abandon.
+struct SegmentView
+{
+	SegmentView(const std::string &name) : address(MAP_FAILED), size(0)
+	{
+		int descriptor = shm_open(name.c_str(), O_RDWR, 0);
+		struct stat status;
+		if (descriptor >= 0 && !fstat(descriptor, &status))
+		{
+			size = static_cast<std::size_t>(status.st_size);
+			address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+		}
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+	}
+
+	~SegmentView()
+	{
+		if (address != MAP_FAILED)
+		{
+			munmap(address, size);
+		}
+	}
+
+	uint32_t *words()
+	{
+		return static_cast<uint32_t*>(address);
+	}
+
+	uint32_t *slot(uint32_t index)
+	{
+		return reinterpret_cast<uint32_t*>(static_cast<char*>(address) + 32 + static_cast<std::size_t>(index) * words()[3]);
+	}
+
+	void *address;
+	std::size_t size;
+};
+
+static int deadProcess()
+{
+	pid_t child = fork();
+	if (!child)
+	{
+		_exit(0);
+	}
+	waitpid(child, NULL, 0);
+	return static_cast<int>(child);
+}
+
+TEST(sharedstore_tombstones)
+{
+	MockAmx amx;
+	AMX_NATIVE openStore = amx.native("OpenGVarSharedStore"), closeStore = amx.native("CloseGVarSharedStore"), setInt = amx.native("SetGVarInt"),
+		getInt = amx.native("GetGVarInt"), remove = amx.native("DeleteGVar"), upper = amx.native("GetGVarsUpperIndex");
+	std::string name = "/gvar-test-store-" + std::to_string(getpid());
+	CHECK(amx.invoke(openStore, std::vector<cell>{ amx.string(name), SHARED_TEST_LOW_ID, SHARED_TEST_HIGH_ID, 8 }) == 1);
+	amx.release();
+	int failedSets = 0;
+	for (int i = 0; i < 1000; ++i)
+	{
+		for (int j = 0; j < 8; ++j)
+		{
+			if (!amx.invoke(setInt, amx.string("k" + std::to_string(i * 8 + j)), j, SHARED_TEST_LOW_ID))
+			{
+				++failedSets;
+			}
+		}
+		for (int j = 0; j < 8; ++j)
+		{
+			amx.invoke(remove, amx.string("k" + std::to_string(i * 8 + j)), SHARED_TEST_LOW_ID);
+		}
+		amx.release();
+	}
+	CHECK(failedSets == 0);
+	CHECK(amx.invoke(upper, SHARED_TEST_LOW_ID) == 0);
+	for (int j = 0; j < 8; ++j)
+	{
+		amx.invoke(setInt, amx.string("full" + std::to_string(j)), j, SHARED_TEST_LOW_ID);
+	}
+	CHECK(amx.invoke(setInt, amx.string("overflow"), 1, SHARED_TEST_LOW_ID) == 0);
+	CHECK(amx.invoke(setInt, amx.string("full3"), 30, SHARED_TEST_LOW_ID) == 1);
+	CHECK(amx.invoke(getInt, amx.string("full3"), SHARED_TEST_LOW_ID) == 30);
+	CHECK(amx.invoke(upper, SHARED_TEST_LOW_ID) > 0);
+	CHECK(amx.invoke(upper, SHARED_TEST_LOW_ID + 1) == 0);
+	CHECK(amx.invoke(setInt, amx.string(std::string(32, 'x')), 1, SHARED_TEST_LOW_ID) == 0);
+	amx.release();
+	amx.invoke(closeStore, std::vector<cell>());
+	shm_unlink(name.c_str());
+}
+
+TEST(sharedstore_dead_owner)
+{
+	MockAmx amx;
+	AMX_NATIVE openStore = amx.native("OpenGVarSharedStore"), closeStore = amx.native("CloseGVarSharedStore"), setInt = amx.native("SetGVarInt"),
+		getInt = amx.native("GetGVarInt");
+	std::string name = "/gvar-test-store-" + std::to_string(getpid());
+	CHECK(amx.invoke(openStore, std::vector<cell>{ amx.string(name), SHARED_TEST_LOW_ID, SHARED_TEST_HIGH_ID, 16 }) == 1);
+	CHECK(amx.invoke(setInt, amx.string("held"), 5, SHARED_TEST_LOW_ID) == 1);
+	amx.release();
+	SegmentView segment(name);
+	CHECK(segment.address != MAP_FAILED);
+	if (segment.address == MAP_FAILED)
+	{
+		return;
+	}
+	int dead = deadProcess();
+	for (uint32_t i = 0; i < segment.words()[2]; ++i)
+	{
+		uint32_t *slot = segment.slot(i);
+		if (!std::strcmp(reinterpret_cast<char*>(slot + 8), "held"))
+		{
+			slot[0] |= 1;
+			slot[1] = static_cast<uint32_t>(dead);
+		}
+	}
+	CHECK(amx.invoke(getInt, amx.string("held"), SHARED_TEST_LOW_ID) == 0);
+	CHECK(amx.invoke(setInt, amx.string("held"), 6, SHARED_TEST_LOW_ID) == 1);
+	CHECK(amx.invoke(getInt, amx.string("held"), SHARED_TEST_LOW_ID) == 6);
+	segment.words()[4] = static_cast<uint32_t>(dead);
+	CHECK(amx.invoke(setInt, amx.string("after"), 7, SHARED_TEST_LOW_ID) == 1);
+	CHECK(segment.words()[4] == 0);
+	amx.release();
+	amx.invoke(closeStore, std::vector<cell>());
+	shm_unlink(name.c_str());
+}
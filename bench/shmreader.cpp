@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reads the segment created by OpenGVarSharedMemory the way a sidecar process
+// would: the segment is mapped read-only and every slot is copied with
+// gvar_shm_read_slot, so no system calls are made after the initial mapping.
+//
+// Usage: gvar-shm-reader <segment name> [interval in milliseconds]
+
+#include <gvar/shm.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static void printSlots(const gvar_shm_header *header)
+{
+	for (uint32_t i = 0; i < header->slot_count; ++i)
+	{
+		gvar_shm_slot slot;
+		gvar_shm_read_slot(gvar_shm_get_slot(header, i), &slot);
+		switch (slot.type)
+		{
+			case GVAR_SHM_TYPE_INT:
+				std::printf("%u\t%d\t%s\tint\t%d\n", i, slot.id, slot.name, slot.value.integer);
+				break;
+			case GVAR_SHM_TYPE_STRING:
+				std::printf("%u\t%d\t%s\tstring\t%s\n", i, slot.id, slot.name, slot.string);
+				break;
+			case GVAR_SHM_TYPE_FLOAT:
+				std::printf("%u\t%d\t%s\tfloat\t%g\n", i, slot.id, slot.name, slot.value.real);
+				break;
+			default:
+				if (slot.name[0])
+				{
+					std::printf("%u\t%d\t%s\tnone\n", i, slot.id, slot.name);
+				}
+				break;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::fprintf(stderr, "Usage: %s <segment name> [interval in milliseconds]\n", argv[0]);
+		return 1;
+	}
+	std::string name = argv[1][0] == '/' ? argv[1] : std::string("/") + argv[1];
+	int interval = argc > 2 ? std::atoi(argv[2]) : 0;
+	int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+	if (descriptor < 0)
+	{
+		std::fprintf(stderr, "Could not open %s\n", name.c_str());
+		return 1;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) < 0 || static_cast<std::size_t>(status.st_size) < sizeof(gvar_shm_header))
+	{
+		std::fprintf(stderr, "%s is not a GVar segment\n", name.c_str());
+		close(descriptor);
+		return 1;
+	}
+	void *address = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (address == MAP_FAILED)
+	{
+		std::fprintf(stderr, "Could not map %s\n", name.c_str());
+		return 1;
+	}
+	const gvar_shm_header *header = static_cast<const gvar_shm_header*>(address);
+	if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != GVAR_SHM_MAGIC || header->version != GVAR_SHM_VERSION || sizeof(gvar_shm_header) + static_cast<std::size_t>(header->slot_count) * header->slot_size > static_cast<std::size_t>(status.st_size))
+	{
+		std::fprintf(stderr, "%s is not a GVar segment\n", name.c_str());
+		munmap(address, status.st_size);
+		return 1;
+	}
+	do
+	{
+		printSlots(header);
+		if (interval > 0)
+		{
+			std::printf("\n");
+			std::fflush(stdout);
+			usleep(static_cast<useconds_t>(interval) * 1000);
+		}
+	}
+	while (interval > 0);
+	munmap(address, status.st_size);
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "main.h"
+#include "mockamx.h"
+#include "slowcalls.h"
+#include "tests.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> logged;
+
+static void captureLog(const char *format, ...)
+{
+	char buffer[512];
+	va_list args;
+	va_start(args, format);
+	std::vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	logged.push_back(buffer);
+}
+
+static bool wasLogged(const std::string &text)
+{
+	for (std::vector<std::string>::const_iterator l = logged.begin(); l != logged.end(); ++l)
+	{
+		if (l->find(text) != std::string::npos)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// A zero threshold makes every call slow regardless of how fast the machine
+// is, so each timed native shows up in the log until the per-minute limit is
+// reached.
+TEST(slowcalls_untraced_natives)
+{
+	MockAmx amx;
+	AMX_NATIVE threshold = amx.native("SetGVarSlowCallThreshold"), load = amx.native("LoadGVarsFromFile"),
+		setIntEx = amx.native("SetGVarIntEx"), ttl = amx.native("SetGVarTTL");
+	logprintf_t original = logprintf;
+	logprintf = captureLog;
+	amx.invoke(threshold, 1, 3);
+	slowCallThreshold = std::chrono::steady_clock::duration::zero();
+	amx.invoke(load, amx.string("gvar-test-missing-file.ini"), 95, 0);
+	amx.invoke(setIntEx, std::vector<cell>{ amx.string("Timed"), 1, 95, 60000 });
+	amx.invoke(ttl, amx.string("timed"), 95, 1000);
+	amx.invoke(ttl, amx.string("timed"), 95, 1000);
+	amx.invoke(threshold, 0, 0);
+	logprintf = original;
+	CHECK(wasLogged("LoadGVarsFromFile(\"gvar-test-missing-file.ini\", ID 95)"));
+	CHECK(wasLogged("SetGVarIntEx(\"timed\", ID 95)"));
+	CHECK(wasLogged("SetGVarTTL(\"timed\", ID 95)"));
+	int slowCalls = 0;
+	for (std::vector<std::string>::const_iterator l = logged.begin(); l != logged.end(); ++l)
+	{
+		if (l->find("slow call:") != std::string::npos)
+		{
+			++slowCalls;
+		}
+	}
+	CHECK(slowCalls == 3);
+	amx.invoke(amx.native("DeleteGVars"), 95);
+	amx.release();
+}
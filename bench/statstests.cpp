@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <vector>
+
+// Lookups start as misses and only count as hits once the GVar was found with
+// the requested type; calls that are not lookups count towards neither.
+TEST(stats_hits_and_misses)
+{
+	MockAmx amx;
+	AMX_NATIVE stats = amx.native("GetGVarStats"), getInt = amx.native("GetGVarInt");
+	cell values = amx.buffer(5);
+	std::vector<cell> arguments;
+	arguments.push_back(amx.string("GetGVarInt"));
+	for (cell i = 0; i < 5; ++i)
+	{
+		arguments.push_back(values + i * static_cast<cell>(sizeof(cell)));
+	}
+#ifdef GVAR_STATS
+	cell *counts = amx.address(values);
+	CHECK(amx.invoke(amx.native("ResetGVarStats"), std::vector<cell>()) == 1);
+	amx.invoke(amx.native("SetGVarInt"), amx.string("present"), 5, 93);
+	amx.invoke(amx.native("SetGVarString"), amx.string("text"), amx.string("5"), 93);
+	amx.invoke(getInt, amx.string("present"), 93);
+	amx.invoke(getInt, amx.string("present"), 93);
+	amx.invoke(getInt, amx.string("missing"), 93);
+	amx.invoke(getInt, amx.string("text"), 93);
+	CHECK(amx.invoke(stats, arguments) == 1);
+	CHECK(counts[0] == 4 && counts[1] == 2 && counts[2] == 2);
+	arguments[0] = amx.string("SetGVarInt");
+	CHECK(amx.invoke(stats, arguments) == 1);
+	CHECK(counts[0] == 1 && counts[1] == 0 && counts[2] == 0);
+	CHECK(amx.invoke(amx.native("ResetGVarStats"), std::vector<cell>()) == 1);
+	CHECK(amx.invoke(stats, arguments) == 1);
+	CHECK(counts[0] == 0);
+	arguments[0] = amx.string("NotANative");
+	CHECK(amx.invoke(stats, arguments) == 0);
+	amx.invoke(amx.native("DeleteGVars"), 93);
+#else
+	amx.invoke(getInt, amx.string("missing"), 93);
+	CHECK(amx.invoke(stats, arguments) == 0);
+#endif
+	amx.release();
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "main.h"
+#include "tests.h"
+
+#include <string>
+
+// Deleting from a namespace that a snapshot still shares must leave the
+// snapshot's copy of the value untouched.
+TEST(store_delete_keeps_snapshot)
+{
+	std::string value(256, 'v');
+	setGVar(40, "first", value);
+	setGVar(40, "second", value);
+	setGVar(41, "only", value);
+	Snapshot snapshot = takeSnapshot(GLOBAL_VARID_ANY);
+	CHECK(deleteGVar(40, "first"));
+	CHECK(deleteGVar(41, "only"));
+	int found = 0;
+	for (Snapshot::const_iterator i = snapshot.begin(); i != snapshot.end(); ++i)
+	{
+		for (DataMap::const_iterator j = i->second->begin(); j != i->second->end(); ++j)
+		{
+			if (i->first == 40 || i->first == 41)
+			{
+				CHECK(boost::get<std::string>(j->second.get<1>()) == value);
+				++found;
+			}
+		}
+	}
+	CHECK(found == 3);
+	CHECK(mainMap.find(41) == mainMap.end());
+	CHECK(mainMap[40]->size() == 1);
+	deleteGVars(40);
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Multi-threaded stress benchmark for the concurrent store. Worker threads
+// read and write random GVars through the plugin API while the main thread
+// plays the server and drains queued writes every tick. The same workload is
+// then run against a single map behind one mutex for comparison.
+//
+// Usage: gvar-stress [seconds per run] [keys] [write percent] [max threads]
+
+#include "concurrent.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+#include <boost/variant.hpp>
+
+#include <gvar/api.h>
+#include <sdk/plugin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+PLUGIN_EXPORT const gvar_api *PLUGIN_CALL GVar_GetApi();
+
+static volatile int sink;
+
+static void printLog(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	std::vprintf(format, args);
+	va_end(args);
+	std::printf("\n");
+}
+
+struct Options
+{
+	double seconds;
+	int keys;
+	int writePercent;
+	int maxThreads;
+};
+
+static std::uint32_t nextRandom(std::uint32_t &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static std::string keyName(int key)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "stress_%d", key);
+	return name;
+}
+
+static double runConcurrent(const gvar_api *api, const Options &options, int threads)
+{
+	std::vector<std::vector<gvar_handle> > handles(threads);
+	for (int t = 0; t < threads; ++t)
+	{
+		for (int k = 0; k < options.keys; ++k)
+		{
+			handles[t].push_back(api->resolve(0, keyName(k).c_str()));
+		}
+	}
+	std::atomic<bool> running(true);
+	std::vector<unsigned long long> operations(threads, 0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			std::uint32_t state = 2463534242u + t * 7919u;
+			unsigned long long count = 0;
+			int checksum = 0;
+			while (running.load(std::memory_order_relaxed))
+			{
+				for (int i = 0; i < 256; ++i)
+				{
+					std::uint32_t r = nextRandom(state);
+					gvar_handle handle = handles[t][r % options.keys];
+					if (static_cast<int>((r >> 24) % 100) < options.writePercent)
+					{
+						api->concurrent_set_int(handle, static_cast<int32_t>(r));
+					}
+					else
+					{
+						int32_t value = 0;
+						api->concurrent_get_int(handle, &value);
+						checksum ^= value;
+					}
+				}
+				count += 256;
+			}
+			operations[t] = count;
+			sink = checksum;
+		}));
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < options.seconds)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		processConcurrent();
+	}
+	running = false;
+	for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); ++w)
+	{
+		w->join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	processConcurrent();
+	for (int t = 0; t < threads; ++t)
+	{
+		std::for_each(handles[t].begin(), handles[t].end(), api->release);
+	}
+	unsigned long long total = 0;
+	for (int t = 0; t < threads; ++t)
+	{
+		total += operations[t];
+	}
+	return total / elapsed;
+}
+
+static double runLocked(const Options &options, int threads)
+{
+	boost::unordered_map<std::string, Value> map;
+	std::mutex mutex;
+	std::vector<std::string> names;
+	for (int k = 0; k < options.keys; ++k)
+	{
+		names.push_back(keyName(k));
+		map[names.back()] = 0;
+	}
+	std::atomic<bool> running(true);
+	std::vector<unsigned long long> operations(threads, 0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			std::uint32_t state = 2463534242u + t * 7919u;
+			unsigned long long count = 0;
+			int checksum = 0;
+			while (running.load(std::memory_order_relaxed))
+			{
+				for (int i = 0; i < 256; ++i)
+				{
+					std::uint32_t r = nextRandom(state);
+					const std::string &name = names[r % options.keys];
+					std::lock_guard<std::mutex> lock(mutex);
+					if (static_cast<int>((r >> 24) % 100) < options.writePercent)
+					{
+						map[name] = static_cast<int>(r);
+					}
+					else
+					{
+						boost::unordered_map<std::string, Value>::iterator f = map.find(name);
+						if (f != map.end() && f->second.type() == typeid(int))
+						{
+							checksum ^= boost::get<int>(f->second);
+						}
+					}
+				}
+				count += 256;
+			}
+			operations[t] = count;
+			sink = checksum;
+		}));
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+	running = false;
+	for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); ++w)
+	{
+		w->join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	unsigned long long total = 0;
+	for (int t = 0; t < threads; ++t)
+	{
+		total += operations[t];
+	}
+	return total / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	options.seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+	options.keys = argc > 2 ? std::max(1, std::atoi(argv[2])) : 100000;
+	options.writePercent = argc > 3 ? std::min(100, std::max(0, std::atoi(argv[3]))) : 50;
+	options.maxThreads = argc > 4 ? std::max(1, std::atoi(argv[4])) : std::max(1u, std::thread::hardware_concurrency());
+	logprintf = printLog;
+	const gvar_api *api = GVar_GetApi();
+	for (int k = 0; k < options.keys; ++k)
+	{
+		setGVar(0, keyName(k), 0);
+	}
+	api->enable_concurrent_reads();
+	std::printf("%d keys, %d%% writes, %.1f s per run, %u hardware threads\n\n", options.keys, options.writePercent, options.seconds, std::thread::hardware_concurrency());
+	std::printf("%8s %16s %8s %16s %8s\n", "threads", "sharded ops/s", "scaling", "mutex ops/s", "scaling");
+	double shardedBase = 0.0, lockedBase = 0.0;
+	for (int threads = 1; threads <= options.maxThreads; threads *= 2)
+	{
+		double sharded = runConcurrent(api, options, threads), locked = runLocked(options, threads);
+		if (threads == 1)
+		{
+			shardedBase = sharded;
+			lockedBase = locked;
+		}
+		std::printf("%8d %16.0f %7.2fx %16.0f %7.2fx\n", threads, sharded, sharded / shardedBase, locked, locked / lockedBase);
+	}
+	api->concurrent_disable();
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <string>
+#include <vector>
+
+TEST(string_compare)
+{
+	MockAmx amx;
+	AMX_NATIVE setString = amx.native("SetGVarString"), setInt = amx.native("SetGVarInt"), compare = amx.native("CompareGVarString");
+	amx.invoke(setString, amx.string("word"), amx.string("Beta"), 90);
+	amx.invoke(setString, amx.string("empty"), amx.string(""), 90);
+	amx.invoke(setInt, amx.string("number"), 5, 90);
+	CHECK(amx.invoke(compare, amx.string("word"), amx.string("Beta"), 0, 90) == 0);
+	CHECK(amx.invoke(compare, amx.string("word"), amx.string("beta"), 0, 90) == -1);
+	CHECK(amx.invoke(compare, amx.string("word"), amx.string("beta"), 1, 90) == 0);
+	CHECK(amx.invoke(compare, amx.string("word"), amx.string("Alpha"), 0, 90) == 1);
+	CHECK(amx.invoke(compare, amx.string("word"), amx.string("Betamax"), 0, 90) == -1);
+	CHECK(amx.invoke(compare, amx.string("empty"), amx.string(""), 0, 90) == 0);
+	CHECK(amx.invoke(compare, amx.string("missing"), amx.string(""), 0, 90) == -2);
+	CHECK(amx.invoke(compare, amx.string("number"), amx.string(""), 0, 90) == -2);
+	amx.invoke(amx.native("DeleteGVars"), 90);
+	amx.release();
+}
+
+static cell packCell(const char *characters)
+{
+	const unsigned char *source = reinterpret_cast<const unsigned char*>(characters);
+	return static_cast<cell>((static_cast<ucell>(source[0]) << 24) | (static_cast<ucell>(source[1]) << 16) | (static_cast<ucell>(source[2]) << 8) | static_cast<ucell>(source[3]));
+}
+
+// Packed strings hold four characters per cell, most significant byte first,
+// and are cut to size * 4 - 1 characters so the terminator always fits.
+TEST(string_packed_getter)
+{
+	MockAmx amx;
+	AMX_NATIVE setString = amx.native("SetGVarString"), setInt = amx.native("SetGVarInt"), packed = amx.native("GetGVarStringPacked"),
+		unpacked = amx.native("GetGVarString");
+	amx.invoke(setString, amx.string("seven"), amx.string("abcdefg"), 91);
+	amx.invoke(setString, amx.string("four"), amx.string("abcd"), 91);
+	amx.invoke(setString, amx.string("high"), amx.string("t\xe9t\xe9z"), 91);
+	amx.invoke(setInt, amx.string("number"), 1, 91);
+	cell buffer = amx.buffer(4);
+	cell *cells = amx.address(buffer);
+	CHECK(amx.invoke(packed, amx.string("seven"), buffer, 4, 91) == 1);
+	CHECK(cells[0] == packCell("abcd") && cells[1] == packCell("efg\0"));
+	CHECK(amx.invoke(packed, amx.string("seven"), buffer, 2, 91) == 1);
+	CHECK(cells[0] == packCell("abcd") && cells[1] == packCell("efg\0"));
+	CHECK(amx.invoke(packed, amx.string("seven"), buffer, 1, 91) == 1);
+	CHECK(cells[0] == packCell("abc\0"));
+	cells[1] = -1;
+	CHECK(amx.invoke(packed, amx.string("four"), buffer, 2, 91) == 1);
+	CHECK(cells[0] == packCell("abcd") && cells[1] == 0);
+	CHECK(amx.invoke(packed, amx.string("high"), buffer, 4, 91) == 1);
+	CHECK(cells[0] == packCell("t\xe9t\xe9") && cells[1] == packCell("z\0\0\0"));
+	cells[0] = 1;
+	CHECK(amx.invoke(packed, amx.string("seven"), buffer, 0, 91) == 1);
+	CHECK(cells[0] == 1);
+	CHECK(amx.invoke(packed, amx.string("missing"), buffer, 4, 91) == 0);
+	CHECK(amx.invoke(packed, amx.string("number"), buffer, 4, 91) == 0);
+	CHECK(amx.invoke(unpacked, amx.string("seven"), buffer, 3, 91) == 1);
+	CHECK(cells[0] == 'a' && cells[1] == 'b' && cells[2] == 0);
+	amx.invoke(amx.native("DeleteGVars"), 91);
+	amx.release();
+}
+
+// The capped append keeps the most recent characters, so a growing log stays
+// within maxLength by dropping its oldest text.
+TEST(string_append_capped)
+{
+	MockAmx amx;
+	AMX_NATIVE append = amx.native("AppendGVarStringCapped"), setInt = amx.native("SetGVarInt");
+	cell buffer = amx.buffer(16);
+	CHECK(amx.invoke(append, amx.string("log"), amx.string("abcdef"), 4, 92) == 4);
+	CHECK(amx.invoke(amx.native("GetGVarString"), amx.string("log"), buffer, 16, 92) == 1);
+	CHECK(amx.read(buffer) == "cdef");
+	CHECK(amx.invoke(append, amx.string("log"), amx.string("gh"), 5, 92) == 5);
+	CHECK(amx.invoke(amx.native("GetGVarString"), amx.string("log"), buffer, 16, 92) == 1);
+	CHECK(amx.read(buffer) == "defgh");
+	CHECK(amx.invoke(append, amx.string("log"), amx.string("i"), 8, 92) == 6);
+	CHECK(amx.invoke(amx.native("GetGVarString"), amx.string("log"), buffer, 16, 92) == 1);
+	CHECK(amx.read(buffer) == "defghi");
+	CHECK(amx.invoke(append, amx.string("log"), amx.string("j"), 0, 92) == 0);
+	CHECK(amx.invoke(amx.native("GetGVarStringLength"), amx.string("log"), 92) == 6);
+	amx.invoke(setInt, amx.string("number"), 1, 92);
+	CHECK(amx.invoke(append, amx.string("number"), amx.string("j"), 4, 92) == 0);
+	amx.invoke(amx.native("DeleteGVars"), 92);
+	amx.release();
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Behaviour tests for the plugin. Tests that go through natives use the mock
+// AMX host from the benchmarks, so they run against the same natives[] table
+// as the server. They run in a temporary directory with its own scriptfiles
+// directory, which is where the plugin resolves file paths.
+//
+// Usage: gvar-tests [test name...]
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+static std::vector<std::pair<const char*, TestFunction> > &getTests()
+{
+	static std::vector<std::pair<const char*, TestFunction> > tests;
+	return tests;
+}
+
+TestCase::TestCase(const char *name, TestFunction function)
+{
+	getTests().push_back(std::make_pair(name, function));
+}
+
+static bool selected(const char *name, int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		return true;
+	}
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp(name, argv[i]))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	int failed = 0, passed = 0;
+	char directory[] = "/tmp/gvar-tests-XXXXXX";
+	if (!mkdtemp(directory) || chdir(directory) || mkdir("scriptfiles", 0755))
+	{
+		std::fprintf(stderr, "Could not create a working directory\n");
+		return 1;
+	}
+	startMockHost();
+	for (std::vector<std::pair<const char*, TestFunction> >::iterator t = getTests().begin(); t != getTests().end(); ++t)
+	{
+		if (!selected(t->first, argc, argv))
+		{
+			continue;
+		}
+		int failures = 0;
+		t->second(failures);
+		std::printf("%-40s %s\n", t->first, failures ? "FAILED" : "ok");
+		if (failures)
+		{
+			++failed;
+		}
+		else
+		{
+			++passed;
+		}
+	}
+	stopMockHost();
+	rmdir("scriptfiles");
+	if (!chdir("/"))
+	{
+		rmdir(directory);
+	}
+	std::printf("%d passed, %d failed\n", passed, failed);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <sdk/plugin.h>
+
+#include <cstdio>
+
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick();
+
+typedef void (*TestFunction)(int &failures);
+
+struct TestCase
+{
+	TestCase(const char *name, TestFunction function);
+};
+
+#define TEST(name) \
+	static void test_##name(int &failures); \
+	static TestCase testCase_##name(#name, test_##name); \
+	static void test_##name(int &failures)
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::printf("    %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} \
+	while (0)
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "main.h"
+#include "mockamx.h"
+#include "tests.h"
+#include "trace.h"
+
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Natives called while a trace is recorded come back from TraceReader in
+// order, with zigzag-encoded negative values and names written only once.
+TEST(trace_roundtrip)
+{
+	MockAmx amx;
+	AMX_NATIVE start = amx.native("StartGVarTrace"), stop = amx.native("StopGVarTrace"), setInt = amx.native("SetGVarInt"),
+		getInt = amx.native("GetGVarInt"), setStringEx = amx.native("SetGVarStringEx"), setTtl = amx.native("SetGVarTTL"),
+		nameAtIndex = amx.native("GetGVarNameAtIndex");
+	std::string path = "gvar-test-" + std::to_string(getpid()) + ".trace";
+	CHECK(amx.invoke(start, amx.string(path)) == 1);
+	amx.invoke(setInt, amx.string("Alpha"), -123456789, -7);
+	amx.invoke(getInt, amx.string("alpha"), -7);
+	amx.invoke(setStringEx, std::vector<cell>{ amx.string("beta"), amx.string("xyz"), 96, 500 });
+	amx.invoke(setTtl, amx.string("beta"), 96, INT_MAX);
+	amx.invoke(nameAtIndex, std::vector<cell>{ 0, amx.buffer(32), 32, 96 });
+	CHECK(amx.invoke(stop, std::vector<cell>()) == 1);
+	amx.release();
+	TraceReader reader("scriptfiles/" + path);
+	CHECK(reader.valid());
+	std::vector<TraceRecord> records;
+	TraceRecord record;
+	while (reader.next(record))
+	{
+		records.push_back(record);
+	}
+	CHECK(records.size() == 5);
+	if (records.size() == 5)
+	{
+		CHECK(records[0].native == TRACE_SETGVARINT && records[0].id == -7 && records[0].name == "alpha" && records[0].value == -123456789);
+		CHECK(records[1].native == TRACE_GETGVARINT && records[1].id == -7 && records[1].name == "alpha");
+		CHECK(records[2].native == TRACE_SETGVARSTRINGEX && records[2].type == GLOBAL_VARTYPE_STRING && records[2].value == 3 && records[2].extra == 500);
+		CHECK(records[3].native == TRACE_SETGVARTTL && records[3].name == "beta" && records[3].value == INT_MAX);
+		CHECK(records[4].native == TRACE_GETGVARNAMEATINDEX && records[4].name.empty() && records[4].value == 0 && records[4].extra == 32);
+	}
+	std::remove(("scriptfiles/" + path).c_str());
+	amx.invoke(amx.native("DeleteGVars"), -7);
+	amx.invoke(amx.native("DeleteGVars"), 96);
+}
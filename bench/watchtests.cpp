@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mockamx.h"
+#include "tests.h"
+
+#include <string>
+#include <vector>
+
+// A change is dropped rather than delivered through a NULL heap address when
+// the script's heap is full.
+TEST(watch_heap_exhausted)
+{
+	MockAmx amx(1 << 14);
+	AMX_NATIVE watch = amx.native("WatchGVar"), setString = amx.native("SetGVarString");
+	int calls = 0;
+	amx.addPublic("OnWatched", [&calls](const std::vector<cell> &arguments) -> cell
+	{
+		++calls;
+		return 1;
+	});
+	CHECK(amx.invoke(watch, amx.string("watched"), 80, amx.string("OnWatched")) != 0);
+	amx.invoke(setString, amx.string("watched"), amx.string(std::string(1000, 's')), 80);
+	amx.release();
+	while (amx.buffer(256))
+	{
+	}
+	while (amx.buffer(1))
+	{
+	}
+	ProcessTick();
+	CHECK(calls == 0);
+	amx.release();
+	amx.invoke(setString, amx.string("watched"), amx.string("short"), 80);
+	amx.release();
+	ProcessTick();
+	CHECK(calls == 1);
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Function table exported by the GVar plugin for other native plugins.
+ *
+ * Look up GVar_GetApi in the loaded gvar.so or gvar.dll (dlsym or
+ * GetProcAddress) and call it once. Check that version is at least the
+ * GVAR_API_VERSION you were built against before using the table.
+ *
+ * A handle names one GVar (an ID and a case-insensitive name) and stays valid
+ * until released, whether or not the GVar exists. Handles cache the location
+ * of the value, so repeated calls skip the name lookup entirely. Unless noted
+ * otherwise, functions must be called from the server thread. resolve and
+ * release may be called from any thread, but a handle must not be used by two
+ * threads at once.
+ */
+
+#ifndef GVAR_API_H
+#define GVAR_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GVAR_API_VERSION (4)
+
+#define GVAR_TYPE_NONE (0)
+#define GVAR_TYPE_INT (1)
+#define GVAR_TYPE_STRING (2)
+#define GVAR_TYPE_FLOAT (3)
+
+#define GVAR_ID_ANY (INT32_MIN)
+
+#if defined _WIN32 || defined WIN32 || defined __WIN32__
+	#define GVAR_CALL __stdcall
+#else
+	#define GVAR_CALL
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gvar_handle_data *gvar_handle;
+
+struct gvar_entry
+{
+	int32_t id;
+	int32_t index;
+	int32_t type;
+	const char *name;
+	int32_t integer;
+	float real;
+	const char *string;
+	size_t length;
+};
+
+/* Return nonzero to stop iterating. Pointers in entry are only valid during the call. */
+typedef int (*gvar_iterate_callback)(void *userdata, const struct gvar_entry *entry);
+
+struct gvar_api
+{
+	uint32_t version;
+	uint32_t size;
+
+	gvar_handle (*resolve)(int32_t id, const char *name);
+	void (*release)(gvar_handle handle);
+
+	int32_t (*get_type)(gvar_handle handle);
+	int (*get_int)(gvar_handle handle, int32_t *value);
+	int (*get_float)(gvar_handle handle, float *value);
+	/* Copies at most size - 1 characters and returns the full length, or -1 if the GVar is not a string. */
+	int32_t (*get_string)(gvar_handle handle, char *buffer, size_t size);
+
+	int (*set_int)(gvar_handle handle, int32_t value);
+	int (*set_float)(gvar_handle handle, float value);
+	int (*set_string)(gvar_handle handle, const char *value, size_t length);
+	int (*remove)(gvar_handle handle);
+
+	/* Iterates over a snapshot, so the callback may modify GVars. */
+	int (*iterate)(int32_t id, gvar_iterate_callback callback, void *userdata);
+
+	/*
+	 * Version 2. Call enable_concurrent_reads once from the server thread; the
+	 * concurrent_get functions may then be called from any thread and never
+	 * block. Stop calling them before the plugin is unloaded. Every GVar is
+	 * then also kept in a replica that all writes are copied into, which
+	 * roughly doubles the memory used by GVars until concurrent_disable.
+	 */
+	int (*enable_concurrent_reads)(void);
+	int32_t (*concurrent_get_type)(gvar_handle handle);
+	int (*concurrent_get_int)(gvar_handle handle, int32_t *value);
+	int (*concurrent_get_float)(gvar_handle handle, float *value);
+	int32_t (*concurrent_get_string)(gvar_handle handle, char *buffer, size_t size);
+
+	/*
+	 * Version 3. After enable_concurrent_reads, the concurrent_set functions
+	 * and concurrent_remove may be called from any thread. Writes to different
+	 * GVars rarely contend. They are visible to concurrent_get at once and to
+	 * Pawn and the other functions after the next server tick.
+	 */
+	int (*concurrent_set_int)(gvar_handle handle, int32_t value);
+	int (*concurrent_set_float)(gvar_handle handle, float value);
+	int (*concurrent_set_string)(gvar_handle handle, const char *value, size_t length);
+	int (*concurrent_remove)(gvar_handle handle);
+
+	/*
+	 * Version 4. Undoes one call to enable_concurrent_reads, from the server
+	 * thread, once your threads have stopped calling the concurrent functions.
+	 * The replica is freed when every plugin that enabled concurrent reads has
+	 * disabled them; after that the concurrent functions fail until they are
+	 * enabled again. Returns 0 if there was no call to undo.
+	 */
+	int (*concurrent_disable)(void);
+};
+
+typedef const struct gvar_api *(GVAR_CALL *gvar_get_api_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
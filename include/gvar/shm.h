@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Layout of the shared memory segment created by OpenGVarSharedMemory.
+ *
+ * The segment starts with a gvar_shm_header followed by slot_count slots of
+ * slot_size bytes each. Every slot is guarded by its own sequence counter:
+ * the plugin makes it odd before changing a slot and even again afterwards,
+ * so readers copy a slot and retry if the counter was odd or changed while
+ * they were copying. Readers never write to the segment.
+ */
+
+#ifndef GVAR_SHM_H
+#define GVAR_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define GVAR_SHM_MAGIC (0x52415647)
+#define GVAR_SHM_VERSION (1)
+
+#define GVAR_SHM_NAME_SIZE (32)
+#define GVAR_SHM_STRING_SIZE (128)
+
+#define GVAR_SHM_TYPE_NONE (0)
+#define GVAR_SHM_TYPE_INT (1)
+#define GVAR_SHM_TYPE_STRING (2)
+#define GVAR_SHM_TYPE_FLOAT (3)
+
+struct gvar_shm_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slot_count;
+	uint32_t slot_size;
+	uint32_t reserved[4];
+};
+
+struct gvar_shm_slot
+{
+	uint32_t sequence;
+	int32_t id;
+	int32_t type;
+	int32_t length;
+	union
+	{
+		int32_t integer;
+		float real;
+	} value;
+	char name[GVAR_SHM_NAME_SIZE];
+	char string[GVAR_SHM_STRING_SIZE];
+};
+
+static inline const struct gvar_shm_slot *gvar_shm_get_slot(const struct gvar_shm_header *header, uint32_t index)
+{
+	return (const struct gvar_shm_slot *)((const char *)(header + 1) + (size_t)index * header->slot_size);
+}
+
+/* Copies a consistent version of a slot into out. */
+static inline void gvar_shm_read_slot(const struct gvar_shm_slot *slot, struct gvar_shm_slot *out)
+{
+	uint32_t before, after;
+	do
+	{
+		before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		memcpy(out, slot, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+	}
+	while ((before & 1) || before != after);
+}
+
+#endif
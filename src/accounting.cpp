@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "accounting.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <cstddef>
+#include <string>
+
+// Sizes of the allocations behind each structure. Hash table nodes hold the
+// element plus a link and the cached hash, buckets are one pointer each, and
+// a namespace is its MainMap node plus the DataMap and its shared_ptr control
+// block. Allocator headers are not counted.
+#define ENTRY_NODE_BYTES (sizeof(DataMap::value_type) + 2 * sizeof(void*))
+#define NAMESPACE_BYTES (sizeof(MainMap::value_type) + 2 * sizeof(void*) + sizeof(DataMap) + 2 * sizeof(long))
+#define INDEX_NODE_BYTES (sizeof(IndexMap::value_type) + 2 * sizeof(void*))
+
+MemoryUsage totalMemory = MemoryUsage();
+
+static boost::unordered_map<int, MemoryUsage> memoryUsage;
+
+// Consecutive writes usually go to the same ID, so the last record is kept
+// to skip the lookup. Records are only erased by forgetMemory.
+static int lastId = 0;
+static MemoryUsage *lastUsage = NULL;
+
+static MemoryUsage &findUsage(int id)
+{
+	if (!lastUsage || lastId != id)
+	{
+		boost::unordered_map<int, MemoryUsage>::iterator u = memoryUsage.find(id);
+		if (u == memoryUsage.end())
+		{
+			u = memoryUsage.insert(std::make_pair(id, MemoryUsage())).first;
+			u->second.nodes = NAMESPACE_BYTES;
+			u->second.indexes = INDEX_NODE_BYTES;
+			totalMemory.nodes += NAMESPACE_BYTES;
+			totalMemory.indexes += INDEX_NODE_BYTES;
+		}
+		lastId = id;
+		lastUsage = &u->second;
+	}
+	return *lastUsage;
+}
+
+// Counters are unsigned, so removals are applied as additions of the
+// negated amount, which wraps back to the right total.
+static void adjustUsage(int id, std::size_t nodes, std::size_t keys, std::size_t strings, int type, std::size_t typeBytes)
+{
+	MemoryUsage &usage = findUsage(id);
+	usage.nodes += nodes;
+	usage.keys += keys;
+	usage.strings += strings;
+	usage.types[type] += typeBytes;
+	totalMemory.nodes += nodes;
+	totalMemory.keys += keys;
+	totalMemory.strings += strings;
+	totalMemory.types[type] += typeBytes;
+}
+
+// Strings short enough for the small string buffer live inside the object
+// and own no heap memory.
+std::size_t getStringBytes(const std::string &string)
+{
+	const char *data = string.data(), *object = reinterpret_cast<const char*>(&string);
+	if (data >= object && data < object + sizeof(std::string))
+	{
+		return 0;
+	}
+	return string.capacity() + 1;
+}
+
+std::size_t getValueBytes(const Value &value)
+{
+	if (value.type() == typeid(std::string))
+	{
+		return getStringBytes(boost::get<std::string>(value));
+	}
+	return 0;
+}
+
+std::size_t getMemoryBytes(const MemoryUsage &usage)
+{
+	return usage.nodes + usage.keys + usage.strings + usage.indexes;
+}
+
+const MemoryUsage *getMemoryUsage(int id)
+{
+	boost::unordered_map<int, MemoryUsage>::iterator u = memoryUsage.find(id);
+	if (u != memoryUsage.end())
+	{
+		return &u->second;
+	}
+	return NULL;
+}
+
+void trackEntry(int id, const std::string &key, const Value &value, bool added)
+{
+	std::size_t keyBytes = getStringBytes(key), valueBytes = getValueBytes(value);
+	if (added)
+	{
+		adjustUsage(id, ENTRY_NODE_BYTES, keyBytes, valueBytes, getType(value), ENTRY_NODE_BYTES + valueBytes);
+	}
+	else
+	{
+		adjustUsage(id, 0 - ENTRY_NODE_BYTES, 0 - keyBytes, 0 - valueBytes, getType(value), 0 - (ENTRY_NODE_BYTES + valueBytes));
+	}
+}
+
+// Called after a value has been replaced in place, with the type and heap
+// bytes of the value it replaced.
+void trackValue(int id, int oldType, std::size_t oldBytes, const Value &value)
+{
+	std::size_t newBytes = getValueBytes(value);
+	int newType = getType(value);
+	adjustUsage(id, 0, 0, newBytes - oldBytes, newType, ENTRY_NODE_BYTES + newBytes);
+	adjustUsage(id, 0, 0, 0, oldType, 0 - (ENTRY_NODE_BYTES + oldBytes));
+}
+
+void trackBuckets(int id, std::size_t buckets)
+{
+	MemoryUsage &usage = findUsage(id);
+	if (usage.buckets != buckets)
+	{
+		std::size_t bytes = (buckets - usage.buckets) * sizeof(void*);
+		usage.nodes += bytes;
+		totalMemory.nodes += bytes;
+		usage.buckets = buckets;
+	}
+}
+
+void trackIndexes(int id, int count)
+{
+	std::size_t bytes = static_cast<std::size_t>(count) * sizeof(int);
+	findUsage(id).indexes += bytes;
+	totalMemory.indexes += bytes;
+}
+
+void forgetMemory(int id)
+{
+	boost::unordered_map<int, MemoryUsage>::iterator u = memoryUsage.find(id);
+	if (u == memoryUsage.end())
+	{
+		return;
+	}
+	totalMemory.nodes -= u->second.nodes;
+	totalMemory.keys -= u->second.keys;
+	totalMemory.strings -= u->second.strings;
+	totalMemory.indexes -= u->second.indexes;
+	for (int t = 0; t < 4; ++t)
+	{
+		totalMemory.types[t] -= u->second.types[t];
+	}
+	memoryUsage.erase(u);
+	lastUsage = NULL;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include "main.h"
+
+#include <cstddef>
+#include <string>
+
+// Byte counts for a namespace or the whole store. types[] is indexed by
+// GLOBAL_VARTYPE_* and holds the node and value bytes of each entry type;
+// key bytes are only counted in keys.
+struct MemoryUsage
+{
+	std::size_t nodes;
+	std::size_t keys;
+	std::size_t strings;
+	std::size_t indexes;
+	std::size_t types[4];
+	std::size_t buckets;
+};
+
+extern MemoryUsage totalMemory;
+
+std::size_t getStringBytes(const std::string &string);
+std::size_t getValueBytes(const Value &value);
+std::size_t getMemoryBytes(const MemoryUsage &usage);
+const MemoryUsage *getMemoryUsage(int id);
+
+void trackEntry(int id, const std::string &key, const Value &value, bool added);
+void trackValue(int id, int oldType, std::size_t oldBytes, const Value &value);
+void trackBuckets(int id, std::size_t buckets);
+void trackIndexes(int id, int count);
+void forgetMemory(int id);
+
+#endif
@@ -0,0 +1,578 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "admin.h"
+#include "expiry.h"
+#include "exporter.h"
+#include "loader.h"
+#include "main.h"
+#include "publisher.h"
+#include "sharedstore.h"
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/variant.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+	#include <poll.h>
+	#include <pthread.h>
+	#include <signal.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+#define ADMIN_POLL_TIMEOUT (200)
+#define ADMIN_REQUEST_TIMEOUT (1000)
+#define ADMIN_IDLE_TIMEOUT (60000)
+#define ADMIN_SEND_TIMEOUT (5)
+
+bool adminActive = false;
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+
+struct Command
+{
+	bool remove;
+	int id;
+	std::string name;
+	Value value;
+};
+
+static int listener = -1;
+static std::string socketPath;
+static std::thread adminThread;
+static std::atomic<bool> adminRunning(false);
+
+enum RequestType
+{
+	REQUEST_VALUE,
+	REQUEST_DATA,
+	REQUEST_SIZES
+};
+
+// A request is answered by ProcessTick with as little as the command needs: a
+// copy of one value, one ID's table, or the size of every ID.
+struct Request
+{
+	Request(int type, int id) : type(type), id(id), found(false) {}
+
+	int type;
+	int id;
+	std::string name;
+	bool found;
+	Value value;
+	std::shared_ptr<const DataMap> data;
+	std::vector<std::pair<int, std::size_t> > sizes;
+};
+
+// The admin thread never touches mainMap. It hands a request to ProcessTick
+// and waits for the answer, and it queues writes for ProcessTick to apply. A
+// request that is answered only after the admin thread stopped waiting is
+// dropped, since a table held here makes the next write to that ID copy it.
+static std::atomic<bool> requestPending(false);
+static std::mutex requestMutex;
+static std::condition_variable requestCondition;
+static Request *pendingRequest = NULL;
+static bool requestAnswered = false;
+
+static std::mutex commandMutex;
+static std::vector<Command> commands;
+
+static bool sendRequest(Request &request)
+{
+	std::unique_lock<std::mutex> lock(requestMutex);
+	pendingRequest = &request;
+	requestAnswered = false;
+	requestPending = true;
+	requestCondition.wait_for(lock, std::chrono::milliseconds(ADMIN_REQUEST_TIMEOUT), []() { return requestAnswered || !adminRunning; });
+	pendingRequest = NULL;
+	return requestAnswered;
+}
+
+static void answerRequest(Request &request)
+{
+	if (request.type == REQUEST_SIZES)
+	{
+		request.sizes.reserve(mainMap.size());
+		for (MainMap::const_iterator i = mainMap.begin(); i != mainMap.end(); ++i)
+		{
+			request.sizes.push_back(std::make_pair(i->first, i->second->size()));
+		}
+		return;
+	}
+	MainMap::const_iterator i = mainMap.find(request.id);
+	if (i == mainMap.end())
+	{
+		return;
+	}
+	if (request.type == REQUEST_DATA)
+	{
+		request.data = i->second;
+		request.found = true;
+	}
+	else
+	{
+		DataMap::const_iterator j = i->second->find(request.name);
+		if (j != i->second->end())
+		{
+			request.value = j->second.get<1>();
+			request.found = true;
+		}
+	}
+}
+
+static void writeData(std::FILE *file, int id, const DataMap &data)
+{
+	std::string line;
+	for (DataMap::const_iterator j = data.begin(); j != data.end() && !std::ferror(file); ++j)
+	{
+		line.clear();
+		writeEntry(line, id, j->first, j->second.get<0>(), j->second.get<1>());
+		std::fputs(line.c_str(), file);
+	}
+}
+
+// Replies are line based, so line breaks and backslashes in names and string
+// values are escaped; values given to set are unescaped the same way.
+static std::string escapeLine(const std::string &string)
+{
+	std::string result;
+	result.reserve(string.length());
+	for (std::string::const_iterator c = string.begin(); c != string.end(); ++c)
+	{
+		switch (*c)
+		{
+			case '\\':
+				result += "\\\\";
+				break;
+			case '\n':
+				result += "\\n";
+				break;
+			case '\r':
+				result += "\\r";
+				break;
+			default:
+				result += *c;
+				break;
+		}
+	}
+	return result;
+}
+
+static std::string unescapeLine(const std::string &string)
+{
+	std::string result;
+	result.reserve(string.length());
+	for (std::string::size_type i = 0; i < string.length(); ++i)
+	{
+		if (string[i] == '\\' && i + 1 < string.length())
+		{
+			switch (string[++i])
+			{
+				case 'n':
+					result += '\n';
+					break;
+				case 'r':
+					result += '\r';
+					break;
+				default:
+					result += string[i];
+					break;
+			}
+		}
+		else
+		{
+			result += string[i];
+		}
+	}
+	return result;
+}
+
+static void writeValue(std::FILE *file, const Value &value)
+{
+	if (value.type() == typeid(int))
+	{
+		std::fprintf(file, "int %d\n", boost::get<int>(value));
+	}
+	else if (value.type() == typeid(std::string))
+	{
+		std::fprintf(file, "string %s\n", escapeLine(boost::get<std::string>(value)).c_str());
+	}
+	else if (value.type() == typeid(float))
+	{
+		std::fprintf(file, "float %.9g\n", boost::get<float>(value));
+	}
+}
+
+static void executeCommand(std::FILE *file, const std::string &line)
+{
+	std::istringstream stream(line);
+	std::string command, name;
+	int id = 0;
+	stream >> command;
+	if (command == "get")
+	{
+		if (!(stream >> id >> name))
+		{
+			std::fputs("error usage: get <id> <name>\n", file);
+			return;
+		}
+		std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+		if (isSharedId(id))
+		{
+			Value value;
+			if (getShared(id, name, value))
+			{
+				writeValue(file, value);
+				return;
+			}
+			std::fputs("none\n", file);
+			return;
+		}
+		Request request(REQUEST_VALUE, id);
+		request.name = name;
+		if (!sendRequest(request))
+		{
+			std::fputs("error server busy\n", file);
+			return;
+		}
+		if (request.found)
+		{
+			writeValue(file, request.value);
+			return;
+		}
+		std::fputs("none\n", file);
+	}
+	else if (command == "list" || command == "stats")
+	{
+		bool filtered = command == "list" && static_cast<bool>(stream >> id);
+		Request request(filtered ? REQUEST_DATA : REQUEST_SIZES, id);
+		if (!sendRequest(request))
+		{
+			std::fputs("error server busy\n", file);
+			return;
+		}
+		if (filtered)
+		{
+			if (request.data)
+			{
+				for (DataMap::const_iterator j = request.data->begin(); j != request.data->end(); ++j)
+				{
+					std::fprintf(file, "%d %s\n", j->second.get<0>(), escapeLine(j->first).c_str());
+				}
+			}
+		}
+		else if (command == "list")
+		{
+			for (std::vector<std::pair<int, std::size_t> >::const_iterator i = request.sizes.begin(); i != request.sizes.end(); ++i)
+			{
+				std::fprintf(file, "%d %u\n", i->first, static_cast<unsigned int>(i->second));
+			}
+		}
+		else
+		{
+			std::size_t entries = 0;
+			for (std::vector<std::pair<int, std::size_t> >::const_iterator i = request.sizes.begin(); i != request.sizes.end(); ++i)
+			{
+				entries += i->second;
+			}
+			std::fprintf(file, "namespaces %u\nentries %u\npublisher %d\nsharedstore %d\n", static_cast<unsigned int>(request.sizes.size()), static_cast<unsigned int>(entries), publisherActive, sharedStoreActive);
+			if (sharedStoreActive)
+			{
+				std::fprintf(file, "sharedids %d %d\n", sharedLowId, sharedHighId);
+			}
+		}
+	}
+	else if (command == "dump")
+	{
+		// Each ID is requested on its own and released once it is written, so
+		// at most one table is held while the client reads.
+		std::vector<int> ids;
+		if (stream >> id)
+		{
+			ids.push_back(id);
+		}
+		else
+		{
+			Request request(REQUEST_SIZES, 0);
+			if (!sendRequest(request))
+			{
+				std::fputs("error server busy\n", file);
+				return;
+			}
+			for (std::vector<std::pair<int, std::size_t> >::const_iterator i = request.sizes.begin(); i != request.sizes.end(); ++i)
+			{
+				ids.push_back(i->first);
+			}
+		}
+		for (std::vector<int>::const_iterator i = ids.begin(); i != ids.end() && !std::ferror(file); ++i)
+		{
+			Request request(REQUEST_DATA, *i);
+			if (!sendRequest(request))
+			{
+				std::fputs("error server busy\n", file);
+				return;
+			}
+			if (request.data)
+			{
+				writeData(file, *i, *request.data);
+			}
+		}
+	}
+	else if (command == "set" || command == "delete")
+	{
+		Command queued;
+		queued.remove = command == "delete";
+		if (!(stream >> queued.id >> queued.name))
+		{
+			std::fprintf(file, "error usage: %s\n", queued.remove ? "delete <id> <name>" : "set <id> <name> <value>");
+			return;
+		}
+		std::transform(queued.name.begin(), queued.name.end(), queued.name.begin(), ::tolower);
+		if (!queued.remove)
+		{
+			std::string value;
+			std::getline(stream >> std::ws, value);
+			value = unescapeLine(value);
+			queued.value = inferValue(value.data(), value.data() + value.length());
+		}
+		std::lock_guard<std::mutex> lock(commandMutex);
+		commands.push_back(queued);
+		std::fputs("queued\n", file);
+	}
+	else if (!command.empty())
+	{
+		std::fprintf(file, "error unknown command \"%s\"\n", command.c_str());
+	}
+}
+
+// Only one client is served at a time, so a client that stays idle is
+// disconnected, and a client that stops reading makes its writes fail after
+// the send timeout rather than blocking the endpoint.
+static void serveClient(int client)
+{
+	timeval timeout = { ADMIN_SEND_TIMEOUT, 0 };
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	std::FILE *file = fdopen(dup(client), "w");
+	if (!file)
+	{
+		return;
+	}
+	std::string buffer;
+	char data[512];
+	std::chrono::steady_clock::time_point lastActivity = std::chrono::steady_clock::now();
+	while (adminRunning && !std::ferror(file))
+	{
+		pollfd descriptor = { client, POLLIN, 0 };
+		int result = poll(&descriptor, 1, ADMIN_POLL_TIMEOUT);
+		if (result < 0)
+		{
+			break;
+		}
+		if (!result)
+		{
+			if (std::chrono::steady_clock::now() - lastActivity >= std::chrono::milliseconds(ADMIN_IDLE_TIMEOUT))
+			{
+				std::fputs("error idle timeout\n", file);
+				break;
+			}
+			continue;
+		}
+		lastActivity = std::chrono::steady_clock::now();
+		ssize_t length = recv(client, data, sizeof(data), 0);
+		if (length <= 0)
+		{
+			break;
+		}
+		buffer.append(data, static_cast<std::size_t>(length));
+		std::string::size_type newline;
+		while ((newline = buffer.find('\n')) != std::string::npos)
+		{
+			std::string line = buffer.substr(0, newline);
+			buffer.erase(0, newline + 1);
+			if (!line.empty() && line[line.length() - 1] == '\r')
+			{
+				line.erase(line.length() - 1);
+			}
+			if (line == "quit")
+			{
+				std::fclose(file);
+				return;
+			}
+			executeCommand(file, line);
+			std::fputc('\n', file);
+			std::fflush(file);
+		}
+	}
+	std::fclose(file);
+}
+
+// Writing to a client that has disconnected raises SIGPIPE, which would kill
+// the server. The signal is blocked on this thread, so the write fails with
+// EPIPE instead.
+static void runAdmin()
+{
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+	while (adminRunning)
+	{
+		pollfd descriptor = { listener, POLLIN, 0 };
+		if (poll(&descriptor, 1, ADMIN_POLL_TIMEOUT) <= 0)
+		{
+			continue;
+		}
+		int client = accept(listener, NULL, NULL);
+		if (client >= 0)
+		{
+			serveClient(client);
+			close(client);
+		}
+	}
+}
+
+bool openAdmin(const std::string &path)
+{
+	sockaddr_un address;
+	if (adminActive || path.length() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+	{
+		return false;
+	}
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	std::strcpy(address.sun_path, path.c_str());
+	unlink(path.c_str());
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listener, 4) < 0)
+	{
+		close(listener);
+		listener = -1;
+		return false;
+	}
+	socketPath = path;
+	adminRunning = true;
+	adminThread = std::thread(runAdmin);
+	adminActive = true;
+	return true;
+}
+
+void closeAdmin()
+{
+	if (!adminActive)
+	{
+		return;
+	}
+	adminRunning = false;
+	requestCondition.notify_all();
+	adminThread.join();
+	close(listener);
+	listener = -1;
+	unlink(socketPath.c_str());
+	commands.clear();
+	adminActive = false;
+}
+
+void processAdmin()
+{
+	if (commandMutex.try_lock())
+	{
+		std::vector<Command> queued;
+		queued.swap(commands);
+		commandMutex.unlock();
+		for (std::vector<Command>::iterator c = queued.begin(); c != queued.end(); ++c)
+		{
+			if (isSharedId(c->id))
+			{
+				if (c->remove)
+				{
+					deleteShared(c->id, c->name);
+				}
+				else
+				{
+					setShared(c->id, c->name, c->value);
+				}
+			}
+			else if (c->remove)
+			{
+				deleteGVar(c->id, c->name);
+			}
+			else
+			{
+				// Like the Set natives, a set clears the TTL. The admin socket is
+				// not a script, so a GVar it creates has no owner and one that a
+				// script owns keeps its owner.
+				if (expiryActive)
+				{
+					clearExpiry(c->id, c->name);
+				}
+				setGVar(c->id, c->name, c->value);
+			}
+		}
+	}
+	if (requestPending.exchange(false))
+	{
+		if (expiryActive)
+		{
+			processExpiry();
+		}
+		{
+			std::lock_guard<std::mutex> lock(requestMutex);
+			if (pendingRequest)
+			{
+				answerRequest(*pendingRequest);
+				requestAnswered = true;
+			}
+		}
+		requestCondition.notify_all();
+	}
+}
+
+#else
+
+bool openAdmin(const std::string &path)
+{
+	logprintf("*** OpenGVarAdminSocket: UNIX domain sockets are not supported on this platform");
+	return false;
+}
+
+void closeAdmin()
+{
+}
+
+void processAdmin()
+{
+}
+
+#endif
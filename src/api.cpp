@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "accounting.h"
+#include "concurrent.h"
+#include "expiry.h"
+#include "main.h"
+#include "reclaimer.h"
+#include "sharedstore.h"
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/variant.hpp>
+
+#include <gvar/api.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <string>
+
+struct gvar_handle_data
+{
+	int id;
+	std::string name;
+	std::size_t hash;
+	unsigned int version;
+	boost::tuple<int, Value> *entry;
+	std::shared_ptr<DataMap> *data;
+};
+
+static boost::tuple<int, Value> *locate(gvar_handle handle)
+{
+	// Deleting an expired GVar bumps storeVersion, so the cached entry below
+	// is looked up again.
+	if (expiryActive)
+	{
+		expireIfDue(handle->id, handle->name);
+	}
+	if (!handle->entry || handle->version != storeVersion)
+	{
+		handle->entry = NULL;
+		handle->data = NULL;
+		MainMap::iterator i = mainMap.find(handle->id);
+		if (i != mainMap.end())
+		{
+			DataMap::iterator j = i->second->find(handle->name);
+			if (j != i->second->end())
+			{
+				handle->entry = &j->second;
+				handle->data = &i->second;
+			}
+		}
+		handle->version = storeVersion;
+	}
+	return handle->entry;
+}
+
+static int setValue(gvar_handle handle, const Value &value)
+{
+	if (isSharedId(handle->id))
+	{
+		return setShared(handle->id, handle->name, value);
+	}
+	if (expiryActive)
+	{
+		clearExpiry(handle->id, handle->name);
+	}
+	boost::tuple<int, Value> *entry = locate(handle);
+	if (entry && handle->data->use_count() == 1)
+	{
+		int oldType = getType(entry->get<1>());
+		std::size_t oldBytes = getValueBytes(entry->get<1>());
+		deferValue(entry->get<1>(), &value);
+		entry->get<1>() = value;
+		trackValue(handle->id, oldType, oldBytes, entry->get<1>());
+		if (writeHooks)
+		{
+			notifyWrite(handle->id, handle->name, &value);
+		}
+		return 1;
+	}
+	setGVar(handle->id, handle->name, value);
+	handle->entry = NULL;
+	return 1;
+}
+
+static gvar_handle resolve(int32_t id, const char *name)
+{
+	if (!name)
+	{
+		return NULL;
+	}
+	gvar_handle handle = new gvar_handle_data;
+	handle->id = id;
+	handle->name = name;
+	std::transform(handle->name.begin(), handle->name.end(), handle->name.begin(), ::tolower);
+	handle->hash = hashConcurrent(id, handle->name);
+	handle->version = 0;
+	handle->entry = NULL;
+	handle->data = NULL;
+	return handle;
+}
+
+static void release(gvar_handle handle)
+{
+	delete handle;
+}
+
+static int32_t getTypeByHandle(gvar_handle handle)
+{
+	if (isSharedId(handle->id))
+	{
+		Value value;
+		return getShared(handle->id, handle->name, value) ? getType(value) : GLOBAL_VARTYPE_NONE;
+	}
+	boost::tuple<int, Value> *entry = locate(handle);
+	return entry ? getType(entry->get<1>()) : GLOBAL_VARTYPE_NONE;
+}
+
+static int getInt(gvar_handle handle, int32_t *result)
+{
+	if (isSharedId(handle->id))
+	{
+		Value value;
+		if (getShared(handle->id, handle->name, value) && value.type() == typeid(int))
+		{
+			*result = boost::get<int>(value);
+			return 1;
+		}
+		return 0;
+	}
+	boost::tuple<int, Value> *entry = locate(handle);
+	if (entry && entry->get<1>().type() == typeid(int))
+	{
+		*result = boost::get<int>(entry->get<1>());
+		return 1;
+	}
+	return 0;
+}
+
+static int getFloat(gvar_handle handle, float *result)
+{
+	if (isSharedId(handle->id))
+	{
+		Value value;
+		if (getShared(handle->id, handle->name, value) && value.type() == typeid(float))
+		{
+			*result = boost::get<float>(value);
+			return 1;
+		}
+		return 0;
+	}
+	boost::tuple<int, Value> *entry = locate(handle);
+	if (entry && entry->get<1>().type() == typeid(float))
+	{
+		*result = boost::get<float>(entry->get<1>());
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t copyString(const std::string &string, char *buffer, size_t size)
+{
+	if (buffer && size)
+	{
+		std::size_t length = std::min(string.length(), size - 1);
+		std::memcpy(buffer, string.data(), length);
+		buffer[length] = '\0';
+	}
+	return static_cast<int32_t>(string.length());
+}
+
+static int32_t getStringByHandle(gvar_handle handle, char *buffer, size_t size)
+{
+	if (isSharedId(handle->id))
+	{
+		Value value;
+		if (getShared(handle->id, handle->name, value) && value.type() == typeid(std::string))
+		{
+			return copyString(boost::get<std::string>(value), buffer, size);
+		}
+		return -1;
+	}
+	boost::tuple<int, Value> *entry = locate(handle);
+	if (entry && entry->get<1>().type() == typeid(std::string))
+	{
+		return copyString(boost::get<std::string>(entry->get<1>()), buffer, size);
+	}
+	return -1;
+}
+
+static int setInt(gvar_handle handle, int32_t value)
+{
+	return setValue(handle, static_cast<int>(value));
+}
+
+static int setFloat(gvar_handle handle, float value)
+{
+	return setValue(handle, value);
+}
+
+static int setStringByHandle(gvar_handle handle, const char *value, size_t length)
+{
+	if (!value)
+	{
+		return 0;
+	}
+	return setValue(handle, std::string(value, length));
+}
+
+static int removeByHandle(gvar_handle handle)
+{
+	if (isSharedId(handle->id))
+	{
+		return deleteShared(handle->id, handle->name);
+	}
+	return deleteGVar(handle->id, handle->name);
+}
+
+static int iterate(int32_t id, gvar_iterate_callback callback, void *userdata)
+{
+	if (!callback)
+	{
+		return 0;
+	}
+	if (expiryActive)
+	{
+		processExpiry();
+	}
+	Snapshot snapshot = takeSnapshot(id);
+	for (Snapshot::iterator i = snapshot.begin(); i != snapshot.end(); ++i)
+	{
+		for (DataMap::const_iterator j = i->second->begin(); j != i->second->end(); ++j)
+		{
+			const Value &value = j->second.get<1>();
+			gvar_entry entry;
+			std::memset(&entry, 0, sizeof(entry));
+			entry.id = i->first;
+			entry.index = j->second.get<0>();
+			entry.type = getType(value);
+			entry.name = j->first.c_str();
+			if (value.type() == typeid(int))
+			{
+				entry.integer = boost::get<int>(value);
+			}
+			else if (value.type() == typeid(float))
+			{
+				entry.real = boost::get<float>(value);
+			}
+			else if (value.type() == typeid(std::string))
+			{
+				entry.string = boost::get<std::string>(value).c_str();
+				entry.length = boost::get<std::string>(value).length();
+			}
+			if (callback(userdata, &entry))
+			{
+				return 1;
+			}
+		}
+	}
+	return 1;
+}
+
+// Plugins enable concurrent reads independently, so the replica is only torn
+// down once each of them has disabled it again.
+static int concurrentEnablers = 0;
+
+static int enableConcurrentReadsByApi()
+{
+	if (!concurrentEnablers++)
+	{
+		enableConcurrentReads();
+	}
+	return 1;
+}
+
+static int disableConcurrentReadsByApi()
+{
+	if (!concurrentEnablers)
+	{
+		return 0;
+	}
+	if (!--concurrentEnablers)
+	{
+		disableConcurrentReads();
+	}
+	return 1;
+}
+
+static bool readValue(gvar_handle handle, Value &value)
+{
+	if (isSharedId(handle->id))
+	{
+		return getShared(handle->id, handle->name, value);
+	}
+	return readConcurrent(handle->id, handle->name, handle->hash, value);
+}
+
+static int32_t concurrentGetType(gvar_handle handle)
+{
+	Value value;
+	return readValue(handle, value) ? getType(value) : GLOBAL_VARTYPE_NONE;
+}
+
+static int concurrentGetInt(gvar_handle handle, int32_t *result)
+{
+	Value value;
+	if (readValue(handle, value) && value.type() == typeid(int))
+	{
+		*result = boost::get<int>(value);
+		return 1;
+	}
+	return 0;
+}
+
+static int concurrentGetFloat(gvar_handle handle, float *result)
+{
+	Value value;
+	if (readValue(handle, value) && value.type() == typeid(float))
+	{
+		*result = boost::get<float>(value);
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t concurrentGetString(gvar_handle handle, char *buffer, size_t size)
+{
+	Value value;
+	if (readValue(handle, value) && value.type() == typeid(std::string))
+	{
+		return copyString(boost::get<std::string>(value), buffer, size);
+	}
+	return -1;
+}
+
+static int writeValue(gvar_handle handle, const Value *value)
+{
+	if (isSharedId(handle->id))
+	{
+		return value ? setShared(handle->id, handle->name, *value) : deleteShared(handle->id, handle->name);
+	}
+	return writeConcurrent(handle->id, handle->name, handle->hash, value);
+}
+
+static int concurrentSetInt(gvar_handle handle, int32_t value)
+{
+	Value v = static_cast<int>(value);
+	return writeValue(handle, &v);
+}
+
+static int concurrentSetFloat(gvar_handle handle, float value)
+{
+	Value v = value;
+	return writeValue(handle, &v);
+}
+
+static int concurrentSetString(gvar_handle handle, const char *value, size_t length)
+{
+	if (!value)
+	{
+		return 0;
+	}
+	Value v = std::string(value, length);
+	return writeValue(handle, &v);
+}
+
+static int concurrentRemove(gvar_handle handle)
+{
+	return writeValue(handle, NULL);
+}
+
+static const gvar_api api =
+{
+	GVAR_API_VERSION,
+	sizeof(gvar_api),
+	resolve,
+	release,
+	getTypeByHandle,
+	getInt,
+	getFloat,
+	getStringByHandle,
+	setInt,
+	setFloat,
+	setStringByHandle,
+	removeByHandle,
+	iterate,
+	enableConcurrentReadsByApi,
+	concurrentGetType,
+	concurrentGetInt,
+	concurrentGetFloat,
+	concurrentGetString,
+	concurrentSetInt,
+	concurrentSetFloat,
+	concurrentSetString,
+	concurrentRemove,
+	disableConcurrentReadsByApi
+};
+
+PLUGIN_EXPORT const gvar_api *PLUGIN_CALL GVar_GetApi()
+{
+	return &api;
+}
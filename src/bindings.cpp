@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bindings.h"
+#include "main.h"
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/variant.hpp>
+
+#include <sdk/plugin.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<AMX*, cell*> > BindingList;
+typedef boost::unordered_map<std::string, BindingList> BindingNameMap;
+
+bool bindingsActive = false;
+
+static boost::unordered_map<int, BindingNameMap> bindings;
+
+static cell bindingValue(const Value *value)
+{
+	if (value && value->type() == typeid(int))
+	{
+		return static_cast<cell>(boost::get<int>(*value));
+	}
+	return 0;
+}
+
+static void updateHook()
+{
+	bindingsActive = !bindings.empty();
+	if (bindingsActive)
+	{
+		writeHooks |= WRITE_HOOK_BINDING;
+	}
+	else
+	{
+		writeHooks &= ~WRITE_HOOK_BINDING;
+	}
+}
+
+bool bindGVar(AMX *amx, int id, const std::string &name, cell *address)
+{
+	BindingList &list = bindings[id][name];
+	for (BindingList::iterator b = list.begin(); b != list.end(); ++b)
+	{
+		if (b->second == address)
+		{
+			return false;
+		}
+	}
+	list.push_back(std::make_pair(amx, address));
+	updateHook();
+	const Value *value = NULL;
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
+		{
+			value = &j->second.get<1>();
+		}
+	}
+	*address = bindingValue(value);
+	return true;
+}
+
+bool unbindGVar(AMX *amx, int id, const std::string &name, cell *address)
+{
+	boost::unordered_map<int, BindingNameMap>::iterator i = bindings.find(id);
+	if (i != bindings.end())
+	{
+		BindingNameMap::iterator j = i->second.find(name);
+		if (j != i->second.end())
+		{
+			for (BindingList::iterator b = j->second.begin(); b != j->second.end(); ++b)
+			{
+				if (b->first == amx && b->second == address)
+				{
+					j->second.erase(b);
+					if (j->second.empty())
+					{
+						i->second.erase(j);
+						if (i->second.empty())
+						{
+							bindings.erase(i);
+						}
+					}
+					updateHook();
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void updateBindings(int id, const std::string &name, const Value *value)
+{
+	boost::unordered_map<int, BindingNameMap>::iterator i = bindings.find(id);
+	if (i != bindings.end())
+	{
+		BindingNameMap::iterator j = i->second.find(name);
+		if (j != i->second.end())
+		{
+			cell result = bindingValue(value);
+			for (BindingList::iterator b = j->second.begin(); b != j->second.end(); ++b)
+			{
+				*b->second = result;
+			}
+		}
+	}
+}
+
+void unbindScript(AMX *amx)
+{
+	for (boost::unordered_map<int, BindingNameMap>::iterator i = bindings.begin(); i != bindings.end(); )
+	{
+		for (BindingNameMap::iterator j = i->second.begin(); j != i->second.end(); )
+		{
+			for (BindingList::iterator b = j->second.begin(); b != j->second.end(); )
+			{
+				if (b->first == amx)
+				{
+					b = j->second.erase(b);
+				}
+				else
+				{
+					++b;
+				}
+			}
+			if (j->second.empty())
+			{
+				j = i->second.erase(j);
+			}
+			else
+			{
+				++j;
+			}
+		}
+		if (i->second.empty())
+		{
+			i = bindings.erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+	updateHook();
+}
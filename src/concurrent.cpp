@@ -0,0 +1,707 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "concurrent.h"
+#include "main.h"
+
+#include <boost/functional/hash.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/variant.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define CONCURRENT_SHARDS (16)
+#define CONCURRENT_INITIAL_BUCKETS (64)
+#define CONCURRENT_LOAD_FACTOR (1)
+#define CONCURRENT_FREE_NODES (1024)
+#define CONCURRENT_RECLAIM_THRESHOLD (1024)
+
+// Replica of the store that any thread can read without locks and write
+// under a per-shard lock. Nodes are never modified after they have been
+// published except for their next pointers, so a reader walking a chain
+// always sees a consistent entry. Replaced and removed nodes are freed once
+// every reader that could still hold them has left its read-side section
+// (epoch-based reclamation). Writes from other threads are queued per shard
+// and copied into mainMap by processConcurrent on the main thread. A shard
+// that outgrows its table is copied into a larger one outside the lock; keys
+// written in the meantime are recorded and copied again before the swap.
+struct Node
+{
+	Node(std::size_t hash, int id, const std::string &name, const Value &value, Node *next) : next(next), hash(hash), id(id), name(name), value(value), queued(false) {}
+
+	std::atomic<Node*> next;
+	std::size_t hash;
+	int id;
+	std::string name;
+	Value value;
+	std::atomic<bool> queued;
+};
+
+struct Table
+{
+	explicit Table(std::size_t size) : size(size), buckets(new std::atomic<Node*>[size])
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			buckets[i].store(NULL, std::memory_order_relaxed);
+		}
+	}
+
+	~Table()
+	{
+		delete[] buckets;
+	}
+
+	std::size_t size;
+	std::atomic<Node*> *buckets;
+};
+
+struct Retired
+{
+	Retired(Node *node, Table *table, bool nodes) : node(node), table(table), nodes(nodes) {}
+
+	Node *node;
+	Table *table;
+	bool nodes;
+};
+
+typedef boost::tuple<std::size_t, int, std::string> ChangedKey;
+
+struct Shard
+{
+	Shard() : table(NULL), count(0), retiredCount(0), growing(false)
+	{
+		lock.clear();
+		for (std::size_t i = 0; i < 3; ++i)
+		{
+			retiredEpoch[i] = 0;
+		}
+	}
+
+	alignas(64) std::atomic_flag lock;
+	std::atomic<Table*> table;
+	std::size_t count;
+	std::vector<Retired> retired[3];
+	unsigned int retiredEpoch[3];
+	std::size_t retiredCount;
+	std::vector<void*> freeNodes;
+	std::vector<std::pair<int, std::string> > pending;
+	std::vector<Table*> deadTables;
+	std::vector<ChangedKey> changed;
+	bool growing;
+};
+
+struct ReaderRecord
+{
+	ReaderRecord() : epoch(0), used(true), next(NULL) {}
+
+	std::atomic<unsigned int> epoch;
+	std::atomic<bool> used;
+	ReaderRecord *next;
+};
+
+struct ReaderHolder
+{
+	ReaderHolder() : record(NULL) {}
+
+	~ReaderHolder()
+	{
+		if (record)
+		{
+			record->used.store(false, std::memory_order_release);
+		}
+	}
+
+	ReaderRecord *record;
+};
+
+bool concurrentReads = false;
+
+static Shard shards[CONCURRENT_SHARDS];
+static std::atomic<unsigned int> globalEpoch(1);
+static std::atomic<ReaderRecord*> readers(NULL);
+static std::atomic<bool> pendingWrites(false);
+static const std::pair<int, std::string> *applyingPending = NULL;
+static thread_local ReaderHolder readerHolder;
+
+class ShardLock
+{
+public:
+	explicit ShardLock(Shard &shard) : shard(shard)
+	{
+		for (unsigned int spins = 0; shard.lock.test_and_set(std::memory_order_acquire); ++spins)
+		{
+			if (spins >= 64)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	~ShardLock()
+	{
+		shard.lock.clear(std::memory_order_release);
+	}
+private:
+	Shard &shard;
+};
+
+static ReaderRecord *acquireRecord()
+{
+	for (ReaderRecord *record = readers.load(std::memory_order_acquire); record; record = record->next)
+	{
+		bool expected = false;
+		if (!record->used.load(std::memory_order_relaxed) && record->used.compare_exchange_strong(expected, true))
+		{
+			return record;
+		}
+	}
+	ReaderRecord *record = new ReaderRecord;
+	record->next = readers.load(std::memory_order_relaxed);
+	while (!readers.compare_exchange_weak(record->next, record))
+	{
+	}
+	return record;
+}
+
+class ReadGuard
+{
+public:
+	ReadGuard()
+	{
+		if (!readerHolder.record)
+		{
+			readerHolder.record = acquireRecord();
+		}
+		record = readerHolder.record;
+		record->epoch.store((globalEpoch.load(std::memory_order_relaxed) << 1) | 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	~ReadGuard()
+	{
+		record->epoch.store(0, std::memory_order_release);
+	}
+private:
+	ReaderRecord *record;
+};
+
+static Node *createNode(Shard &shard, std::size_t hash, int id, const std::string &name, const Value &value, Node *next)
+{
+	void *memory = NULL;
+	if (!shard.freeNodes.empty())
+	{
+		memory = shard.freeNodes.back();
+		shard.freeNodes.pop_back();
+	}
+	else
+	{
+		memory = ::operator new(sizeof(Node));
+	}
+	return new (memory) Node(hash, id, name, value, next);
+}
+
+static void destroyNode(Shard &shard, Node *node)
+{
+	node->~Node();
+	if (shard.freeNodes.size() < CONCURRENT_FREE_NODES)
+	{
+		shard.freeNodes.push_back(node);
+	}
+	else
+	{
+		::operator delete(node);
+	}
+}
+
+static void freeRetired(Shard &shard, std::vector<Retired> &list)
+{
+	for (std::vector<Retired>::iterator r = list.begin(); r != list.end(); ++r)
+	{
+		if (r->node)
+		{
+			destroyNode(shard, r->node);
+		}
+		if (r->nodes)
+		{
+			shard.deadTables.push_back(r->table);
+		}
+		else
+		{
+			delete r->table;
+		}
+	}
+	shard.retiredCount -= list.size();
+	list.clear();
+}
+
+// A table retired together with its nodes is only moved to deadTables here,
+// so that it can be destroyed after the shard lock has been released.
+static void retire(Shard &shard, Node *node, Table *table, bool nodes)
+{
+	unsigned int epoch = globalEpoch.load(std::memory_order_acquire), index = epoch % 3;
+	if (shard.retiredEpoch[index] != epoch)
+	{
+		freeRetired(shard, shard.retired[index]);
+		shard.retiredEpoch[index] = epoch;
+	}
+	shard.retired[index].push_back(Retired(node, table, nodes));
+	++shard.retiredCount;
+}
+
+static bool tryAdvanceEpoch()
+{
+	unsigned int epoch = globalEpoch.load(std::memory_order_acquire), active = (epoch << 1) | 1;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (ReaderRecord *record = readers.load(std::memory_order_acquire); record; record = record->next)
+	{
+		unsigned int announced = record->epoch.load(std::memory_order_acquire);
+		if ((announced & 1) && announced != active)
+		{
+			return false;
+		}
+	}
+	return globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+static void reclaim(Shard &shard)
+{
+	unsigned int epoch = globalEpoch.load(std::memory_order_acquire);
+	for (std::size_t i = 0; i < 3; ++i)
+	{
+		if (!shard.retired[i].empty() && shard.retiredEpoch[i] + 2 <= epoch)
+		{
+			freeRetired(shard, shard.retired[i]);
+		}
+	}
+}
+
+static std::size_t bucketOf(std::size_t hash, std::size_t size)
+{
+	return (hash / CONCURRENT_SHARDS) & (size - 1);
+}
+
+static void insertNode(Table *table, Node *node)
+{
+	std::atomic<Node*> &head = table->buckets[bucketOf(node->hash, table->size)];
+	node->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	head.store(node, std::memory_order_release);
+}
+
+static Node *findNode(Shard &shard, std::size_t hash, int id, const std::string &name)
+{
+	Table *table = shard.table.load(std::memory_order_acquire);
+	if (table)
+	{
+		for (Node *node = table->buckets[bucketOf(hash, table->size)].load(std::memory_order_acquire); node; node = node->next.load(std::memory_order_acquire))
+		{
+			if (node->hash == hash && node->id == id && node->name == name)
+			{
+				return node;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void destroyTables(std::vector<Table*> &tables)
+{
+	for (std::vector<Table*>::iterator t = tables.begin(); t != tables.end(); ++t)
+	{
+		for (std::size_t i = 0; i < (*t)->size; ++i)
+		{
+			for (Node *node = (*t)->buckets[i].load(std::memory_order_relaxed); node; )
+			{
+				Node *next = node->next.load(std::memory_order_relaxed);
+				delete node;
+				node = next;
+			}
+		}
+		delete *t;
+	}
+	tables.clear();
+}
+
+static Node *copyNode(const Node *node)
+{
+	Node *copy = new Node(node->hash, node->id, node->name, node->value, NULL);
+	copy->queued.store(node->queued.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	return copy;
+}
+
+// Called with the shard locked after a write. Returns true if the caller
+// should grow the shard once it has released the lock.
+static bool startGrow(Shard &shard)
+{
+	Table *table = shard.table.load(std::memory_order_relaxed);
+	if (shard.growing || shard.count <= table->size * CONCURRENT_LOAD_FACTOR)
+	{
+		return false;
+	}
+	shard.growing = true;
+	return true;
+}
+
+static void grow(Shard &shard)
+{
+	Table *table = shard.table.load(std::memory_order_acquire), *replacement = new Table(table->size * 2);
+	{
+		ReadGuard guard;
+		for (std::size_t i = 0; i < table->size; ++i)
+		{
+			for (Node *node = table->buckets[i].load(std::memory_order_acquire); node; node = node->next.load(std::memory_order_acquire))
+			{
+				insertNode(replacement, copyNode(node));
+			}
+		}
+	}
+	std::vector<Table*> dead;
+	{
+		ShardLock lock(shard);
+		for (std::vector<ChangedKey>::iterator k = shard.changed.begin(); k != shard.changed.end(); ++k)
+		{
+			std::size_t hash = k->get<0>();
+			std::atomic<Node*> *link = &replacement->buckets[bucketOf(hash, replacement->size)];
+			for (Node *node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed))
+			{
+				if (node->hash == hash && node->id == k->get<1>() && node->name == k->get<2>())
+				{
+					link->store(node->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					delete node;
+					break;
+				}
+				link = &node->next;
+			}
+			Node *current = findNode(shard, hash, k->get<1>(), k->get<2>());
+			if (current)
+			{
+				insertNode(replacement, copyNode(current));
+			}
+		}
+		shard.changed.clear();
+		shard.growing = false;
+		shard.table.store(replacement, std::memory_order_release);
+		retire(shard, NULL, table, true);
+		dead.swap(shard.deadTables);
+	}
+	destroyTables(dead);
+}
+
+static Node *update(Shard &shard, std::size_t hash, int id, const std::string &name, const Value *value)
+{
+	Table *table = shard.table.load(std::memory_order_relaxed);
+	std::atomic<Node*> *link = &table->buckets[bucketOf(hash, table->size)];
+	for (Node *node = link->load(std::memory_order_relaxed); node; node = link->load(std::memory_order_relaxed))
+	{
+		if (node->hash == hash && node->id == id && node->name == name)
+		{
+			Node *replacement = NULL;
+			if (value)
+			{
+				replacement = createNode(shard, hash, id, name, *value, node->next.load(std::memory_order_relaxed));
+				replacement->queued.store(node->queued.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				link->store(replacement, std::memory_order_release);
+			}
+			else
+			{
+				link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+				--shard.count;
+			}
+			retire(shard, node, NULL, false);
+			if (shard.growing)
+			{
+				shard.changed.push_back(ChangedKey(hash, id, name));
+			}
+			return replacement;
+		}
+		link = &node->next;
+	}
+	if (value)
+	{
+		Node *node = createNode(shard, hash, id, name, *value, NULL);
+		insertNode(table, node);
+		++shard.count;
+		if (shard.growing)
+		{
+			shard.changed.push_back(ChangedKey(hash, id, name));
+		}
+		return node;
+	}
+	return NULL;
+}
+
+
+std::size_t hashConcurrent(int id, const std::string &name)
+{
+	std::size_t hash = boost::hash<std::string>()(name);
+	boost::hash_combine(hash, id);
+	return hash;
+}
+
+void enableConcurrentReads()
+{
+	if (concurrentReads)
+	{
+		return;
+	}
+	for (std::size_t i = 0; i < CONCURRENT_SHARDS; ++i)
+	{
+		shards[i].table.store(new Table(CONCURRENT_INITIAL_BUCKETS), std::memory_order_release);
+		shards[i].count = 0;
+	}
+	concurrentReads = true;
+	writeHooks |= WRITE_HOOK_CONCURRENT;
+	for (MainMap::iterator i = mainMap.begin(); i != mainMap.end(); ++i)
+	{
+		for (DataMap::iterator j = i->second->begin(); j != i->second->end(); ++j)
+		{
+			updateConcurrent(i->first, j->first, &j->second.get<1>());
+		}
+	}
+}
+
+// Detaching a shard under its lock keeps other threads from writing to it, and
+// writes they queued before that are copied into mainMap afterwards. Readers
+// that loaded a table before it was detached are waited for before any node
+// is freed, so a plugin may disable concurrent reads while the server runs.
+void disableConcurrentReads()
+{
+	if (!concurrentReads)
+	{
+		return;
+	}
+	writeHooks &= ~WRITE_HOOK_CONCURRENT;
+	concurrentReads = false;
+	Table *tables[CONCURRENT_SHARDS];
+	std::vector<std::pair<std::pair<int, std::string>, Value> > writes;
+	std::vector<std::pair<int, std::string> > removals;
+	for (std::size_t i = 0; i < CONCURRENT_SHARDS; ++i)
+	{
+		Shard &shard = shards[i];
+		bool detached = false;
+		while (!detached)
+		{
+			{
+				ShardLock lock(shard);
+				if (!shard.growing)
+				{
+					for (std::vector<std::pair<int, std::string> >::iterator p = shard.pending.begin(); p != shard.pending.end(); ++p)
+					{
+						Node *node = findNode(shard, hashConcurrent(p->first, p->second), p->first, p->second);
+						if (node)
+						{
+							writes.push_back(std::make_pair(*p, node->value));
+						}
+						else
+						{
+							removals.push_back(*p);
+						}
+					}
+					shard.pending.clear();
+					tables[i] = shard.table.exchange(NULL);
+					detached = true;
+				}
+			}
+			if (!detached)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+	pendingWrites.store(false, std::memory_order_relaxed);
+	unsigned int active = ((globalEpoch.fetch_add(1) + 1) << 1) | 1;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (ReaderRecord *record = readers.load(std::memory_order_acquire); record; record = record->next)
+	{
+		for (unsigned int announced = record->epoch.load(std::memory_order_acquire); (announced & 1) && announced != active; announced = record->epoch.load(std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+	}
+	for (std::size_t i = 0; i < CONCURRENT_SHARDS; ++i)
+	{
+		Shard &shard = shards[i];
+		Table *table = tables[i];
+		for (std::size_t j = 0; j < table->size; ++j)
+		{
+			for (Node *node = table->buckets[j].load(std::memory_order_relaxed); node; )
+			{
+				Node *next = node->next.load(std::memory_order_relaxed);
+				destroyNode(shard, node);
+				node = next;
+			}
+		}
+		delete table;
+		for (std::size_t j = 0; j < 3; ++j)
+		{
+			freeRetired(shard, shard.retired[j]);
+		}
+		destroyTables(shard.deadTables);
+		for (std::vector<void*>::iterator n = shard.freeNodes.begin(); n != shard.freeNodes.end(); ++n)
+		{
+			::operator delete(*n);
+		}
+		shard.freeNodes.clear();
+		shard.changed.clear();
+		shard.count = 0;
+	}
+	for (std::vector<std::pair<std::pair<int, std::string>, Value> >::iterator w = writes.begin(); w != writes.end(); ++w)
+	{
+		setGVar(w->first.first, w->first.second, w->second);
+	}
+	for (std::vector<std::pair<int, std::string> >::iterator r = removals.begin(); r != removals.end(); ++r)
+	{
+		deleteGVar(r->first, r->second);
+	}
+}
+
+void updateConcurrent(int id, const std::string &name, const Value *value)
+{
+	if (applyingPending && applyingPending->first == id && applyingPending->second == name)
+	{
+		return;
+	}
+	std::size_t hash = hashConcurrent(id, name);
+	Shard &shard = shards[hash % CONCURRENT_SHARDS];
+	std::vector<Table*> dead;
+	bool expand = false;
+	{
+		ShardLock lock(shard);
+		update(shard, hash, id, name, value);
+		expand = startGrow(shard);
+		dead.swap(shard.deadTables);
+	}
+	destroyTables(dead);
+	if (expand)
+	{
+		grow(shard);
+	}
+}
+
+bool readConcurrent(int id, const std::string &name, std::size_t hash, Value &value)
+{
+	ReadGuard guard;
+	Node *node = findNode(shards[hash % CONCURRENT_SHARDS], hash, id, name);
+	if (node)
+	{
+		value = node->value;
+		return true;
+	}
+	return false;
+}
+
+bool writeConcurrent(int id, const std::string &name, std::size_t hash, const Value *value)
+{
+	Shard &shard = shards[hash % CONCURRENT_SHARDS];
+	std::vector<Table*> dead;
+	bool expand = false;
+	{
+		ShardLock lock(shard);
+		if (!shard.table.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+		Node *node = update(shard, hash, id, name, value);
+		if (!node || !node->queued.load(std::memory_order_relaxed))
+		{
+			if (node)
+			{
+				node->queued.store(true, std::memory_order_relaxed);
+			}
+			shard.pending.push_back(std::make_pair(id, name));
+			pendingWrites.store(true, std::memory_order_relaxed);
+		}
+		if (shard.retiredCount >= CONCURRENT_RECLAIM_THRESHOLD)
+		{
+			tryAdvanceEpoch();
+			reclaim(shard);
+		}
+		expand = startGrow(shard);
+		dead.swap(shard.deadTables);
+	}
+	destroyTables(dead);
+	if (expand)
+	{
+		grow(shard);
+	}
+	return true;
+}
+
+void processConcurrent()
+{
+	if (pendingWrites.exchange(false, std::memory_order_acquire))
+	{
+		for (std::size_t i = 0; i < CONCURRENT_SHARDS; ++i)
+		{
+			std::vector<std::pair<int, std::string> > pending;
+			{
+				ShardLock lock(shards[i]);
+				pending.swap(shards[i].pending);
+			}
+			// The replica holds the most recent value of every key, so mainMap
+			// copies it instead of replaying each queued write in order. Keys
+			// stay queued only once until they are copied. Only the key being
+			// copied skips the replica; keys that the write evicts still leave it.
+			for (std::vector<std::pair<int, std::string> >::iterator p = pending.begin(); p != pending.end(); ++p)
+			{
+				applyingPending = &*p;
+				Value value;
+				bool found = false;
+				{
+					std::size_t hash = hashConcurrent(p->first, p->second);
+					ShardLock lock(shards[i]);
+					Node *node = findNode(shards[i], hash, p->first, p->second);
+					if (node)
+					{
+						value = node->value;
+						node->queued.store(false, std::memory_order_relaxed);
+						found = true;
+						if (shards[i].growing)
+						{
+							shards[i].changed.push_back(ChangedKey(hash, p->first, p->second));
+						}
+					}
+				}
+				if (found)
+				{
+					setGVar(p->first, p->second, value);
+				}
+				else
+				{
+					deleteGVar(p->first, p->second);
+				}
+			}
+			applyingPending = NULL;
+		}
+	}
+	tryAdvanceEpoch();
+	for (std::size_t i = 0; i < CONCURRENT_SHARDS; ++i)
+	{
+		std::vector<Table*> dead;
+		{
+			ShardLock lock(shards[i]);
+			reclaim(shards[i]);
+			dead.swap(shards[i].deadTables);
+		}
+		destroyTables(dead);
+	}
+}
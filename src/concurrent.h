@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CONCURRENT_H
+#define CONCURRENT_H
+
+#include "main.h"
+
+#include <cstddef>
+#include <string>
+
+extern bool concurrentReads;
+
+std::size_t hashConcurrent(int id, const std::string &name);
+void enableConcurrentReads();
+void disableConcurrentReads();
+void updateConcurrent(int id, const std::string &name, const Value *value);
+bool readConcurrent(int id, const std::string &name, std::size_t hash, Value &value);
+bool writeConcurrent(int id, const std::string &name, std::size_t hash, const Value *value);
+void processConcurrent();
+
+#endif
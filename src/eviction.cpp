@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "eviction.h"
+#include "accounting.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <sdk/plugin.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct CacheRange
+{
+	int lowId;
+	int highId;
+	std::size_t maxEntries;
+	std::size_t maxBytes;
+	AMX *owner;
+	bool callback;
+};
+
+struct CacheSlot
+{
+	std::string name;
+	bool referenced;
+	bool used;
+};
+
+// Every capped ID keeps its GVar names in a CLOCK ring. Reads only set the
+// referenced flag of a slot; the hand clears flags as it passes and evicts
+// the first GVar that was not referenced since the last sweep.
+struct Cache
+{
+	std::vector<CacheSlot> slots;
+	std::vector<std::size_t> freeSlots;
+	boost::unordered_map<std::string, std::size_t> positions;
+	std::size_t hand;
+};
+
+struct Eviction
+{
+	AMX *amx;
+	int id;
+	std::string name;
+};
+
+bool cachesActive = false;
+bool evictionsPending = false;
+
+static std::vector<CacheRange> cacheRanges;
+static boost::unordered_map<int, Cache> caches;
+static std::vector<Eviction> evictions;
+static bool evictionSuspended = false;
+static bool evicting = false;
+
+static const CacheRange *findRange(int id)
+{
+	for (std::vector<CacheRange>::const_iterator r = cacheRanges.begin(); r != cacheRanges.end(); ++r)
+	{
+		if (id >= r->lowId && id <= r->highId)
+		{
+			return &*r;
+		}
+	}
+	return NULL;
+}
+
+static void addSlot(Cache &cache, const std::string &name)
+{
+	CacheSlot slot = { name, false, true };
+	std::size_t position = cache.slots.size();
+	if (!cache.freeSlots.empty())
+	{
+		position = cache.freeSlots.back();
+		cache.freeSlots.pop_back();
+		cache.slots[position] = slot;
+	}
+	else
+	{
+		cache.slots.push_back(slot);
+	}
+	cache.positions[name] = position;
+}
+
+static bool overLimit(int id, const CacheRange &range)
+{
+	MainMap::iterator i = mainMap.find(id);
+	if (i == mainMap.end())
+	{
+		return false;
+	}
+	if (range.maxEntries && i->second->size() > range.maxEntries)
+	{
+		return true;
+	}
+	if (range.maxBytes)
+	{
+		const MemoryUsage *usage = getMemoryUsage(id);
+		return usage && getMemoryBytes(*usage) > range.maxBytes;
+	}
+	return false;
+}
+
+// Evicts until the ID is back under its limits. The GVar being written is
+// never evicted, so a single value larger than the byte limit is kept. The
+// cache is erased here rather than in updateCache once it runs empty.
+static void evict(int id, const CacheRange &range, Cache &cache, const std::string *protect)
+{
+	std::size_t keep = protect ? 1 : 0;
+	evicting = true;
+	while (cache.positions.size() > keep && overLimit(id, range))
+	{
+		if (cache.hand >= cache.slots.size())
+		{
+			cache.hand = 0;
+		}
+		CacheSlot &slot = cache.slots[cache.hand++];
+		if (!slot.used || (protect && slot.name == *protect))
+		{
+			continue;
+		}
+		if (slot.referenced)
+		{
+			slot.referenced = false;
+			continue;
+		}
+		std::string name = slot.name;
+		if (!deleteGVar(id, name))
+		{
+			slot.used = false;
+			cache.positions.erase(name);
+			cache.freeSlots.push_back(cache.hand - 1);
+			continue;
+		}
+		if (range.callback)
+		{
+			Eviction eviction = { range.owner, id, name };
+			evictions.push_back(eviction);
+			evictionsPending = true;
+		}
+	}
+	evicting = false;
+	if (cache.positions.empty())
+	{
+		caches.erase(id);
+	}
+}
+
+bool setCacheLimit(AMX *amx, int lowId, int highId, int maxEntries, int maxBytes, bool callback)
+{
+	if (lowId > highId || maxEntries < 0 || maxBytes < 0)
+	{
+		return false;
+	}
+	for (std::vector<CacheRange>::iterator r = cacheRanges.begin(); r != cacheRanges.end(); ++r)
+	{
+		if (r->lowId == lowId && r->highId == highId)
+		{
+			cacheRanges.erase(r);
+			break;
+		}
+	}
+	for (boost::unordered_map<int, Cache>::iterator c = caches.begin(); c != caches.end(); )
+	{
+		if (c->first >= lowId && c->first <= highId)
+		{
+			c = caches.erase(c);
+		}
+		else
+		{
+			++c;
+		}
+	}
+	if (maxEntries || maxBytes)
+	{
+		CacheRange range = { lowId, highId, static_cast<std::size_t>(maxEntries), static_cast<std::size_t>(maxBytes), amx, callback };
+		cacheRanges.push_back(range);
+		std::vector<int> ids;
+		for (MainMap::iterator i = mainMap.begin(); i != mainMap.end(); ++i)
+		{
+			if (i->first >= lowId && i->first <= highId && findRange(i->first) == &cacheRanges.back())
+			{
+				Cache &cache = caches[i->first];
+				for (DataMap::iterator j = i->second->begin(); j != i->second->end(); ++j)
+				{
+					addSlot(cache, j->first);
+				}
+				ids.push_back(i->first);
+			}
+		}
+		cachesActive = true;
+		writeHooks |= WRITE_HOOK_EVICTION;
+		for (std::vector<int>::iterator i = ids.begin(); i != ids.end(); ++i)
+		{
+			enforceCache(*i);
+		}
+	}
+	else if (cacheRanges.empty())
+	{
+		cachesActive = false;
+		writeHooks &= ~WRITE_HOOK_EVICTION;
+	}
+	return true;
+}
+
+void touchCache(int id, const std::string &name)
+{
+	boost::unordered_map<int, Cache>::iterator c = caches.find(id);
+	if (c != caches.end())
+	{
+		boost::unordered_map<std::string, std::size_t>::iterator p = c->second.positions.find(name);
+		if (p != c->second.positions.end())
+		{
+			c->second.slots[p->second].referenced = true;
+		}
+	}
+}
+
+void updateCache(int id, const std::string &name, const Value *value)
+{
+	if (!value)
+	{
+		boost::unordered_map<int, Cache>::iterator c = caches.find(id);
+		if (c != caches.end())
+		{
+			boost::unordered_map<std::string, std::size_t>::iterator p = c->second.positions.find(name);
+			if (p != c->second.positions.end())
+			{
+				c->second.slots[p->second].used = false;
+				c->second.slots[p->second].name.clear();
+				c->second.freeSlots.push_back(p->second);
+				c->second.positions.erase(p);
+			}
+			if (c->second.positions.empty() && !evicting)
+			{
+				caches.erase(c);
+			}
+		}
+		return;
+	}
+	const CacheRange *range = findRange(id);
+	if (!range)
+	{
+		return;
+	}
+	Cache &cache = caches[id];
+	boost::unordered_map<std::string, std::size_t>::iterator p = cache.positions.find(name);
+	if (p != cache.positions.end())
+	{
+		cache.slots[p->second].referenced = true;
+	}
+	else
+	{
+		addSlot(cache, name);
+	}
+	if (!evictionSuspended)
+	{
+		evict(id, *range, cache, &name);
+	}
+}
+
+// Bulk writers that hold a DataMap reference across several writes suspend
+// eviction and call enforceCache once they are done.
+void suspendEviction(bool suspend)
+{
+	evictionSuspended = suspend;
+}
+
+void enforceCache(int id)
+{
+	const CacheRange *range = findRange(id);
+	boost::unordered_map<int, Cache>::iterator c = caches.find(id);
+	if (range && c != caches.end())
+	{
+		evict(id, *range, c->second, NULL);
+	}
+}
+
+void processEvictions()
+{
+	std::vector<Eviction> delivered;
+	delivered.swap(evictions);
+	evictionsPending = false;
+	for (std::vector<Eviction>::iterator e = delivered.begin(); e != delivered.end(); ++e)
+	{
+		int index = 0;
+		if (amx_FindPublic(e->amx, "OnGVarEvicted", &index) == AMX_ERR_NONE)
+		{
+			cell address = 0, *physical = NULL;
+			if (amx_Allot(e->amx, static_cast<int>(e->name.length()) + 1, &address, &physical) != AMX_ERR_NONE)
+			{
+				logprintf("*** GVar eviction: Not enough heap space in the script to report the eviction of \"%s\"", e->name.c_str());
+				continue;
+			}
+			amx_SetString(physical, e->name.c_str(), 0, 0, static_cast<int>(e->name.length()) + 1);
+			amx_Push(e->amx, address);
+			amx_Push(e->amx, static_cast<cell>(e->id));
+			amx_Exec(e->amx, NULL, index);
+			amx_Release(e->amx, address);
+		}
+	}
+}
+
+// Limits set by an unloaded script stay in place, but its callbacks are
+// dropped.
+void releaseCaches(AMX *amx)
+{
+	for (std::vector<CacheRange>::iterator r = cacheRanges.begin(); r != cacheRanges.end(); ++r)
+	{
+		if (r->owner == amx)
+		{
+			r->owner = NULL;
+			r->callback = false;
+		}
+	}
+	for (std::vector<Eviction>::iterator e = evictions.begin(); e != evictions.end(); )
+	{
+		if (e->amx == amx)
+		{
+			e = evictions.erase(e);
+		}
+		else
+		{
+			++e;
+		}
+	}
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EVICTION_H
+#define EVICTION_H
+
+#include "main.h"
+
+#include <sdk/plugin.h>
+
+#include <string>
+
+extern bool cachesActive;
+extern bool evictionsPending;
+
+bool setCacheLimit(AMX *amx, int lowId, int highId, int maxEntries, int maxBytes, bool callback);
+void touchCache(int id, const std::string &name);
+void updateCache(int id, const std::string &name, const Value *value);
+void suspendEviction(bool suspend);
+void enforceCache(int id);
+void processEvictions();
+void releaseCaches(AMX *amx);
+
+#endif
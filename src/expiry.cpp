@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "expiry.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <utility>
+
+// Hierarchical timer wheel with millisecond ticks. Level n has WHEEL_SIZE
+// slots of WHEEL_SIZE^n ticks each, so the four levels cover about 4.6 hours;
+// later expiry times wait in the last slot of the top level and are placed
+// again when it comes round. A timer is inserted and removed in O(1) and is
+// moved down at most once per level before it fires.
+#define WHEEL_BITS (6)
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS (4)
+
+struct Timer
+{
+	int id;
+	std::string name;
+	unsigned long long expires;
+	int level;
+	int slot;
+};
+
+typedef std::list<Timer> TimerList;
+typedef std::pair<int, std::string> TimerKey;
+
+bool expiryActive = false;
+
+static TimerList wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static boost::unordered_map<TimerKey, TimerList::iterator> timers;
+static unsigned long long currentTick = 0;
+static std::chrono::steady_clock::time_point baseTime = std::chrono::steady_clock::now();
+
+static unsigned long long getTick()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - baseTime).count();
+}
+
+static void placeTimer(TimerList &source, TimerList::iterator t)
+{
+	unsigned long long expires = t->expires > currentTick ? t->expires : currentTick + 1, delta = expires - currentTick;
+	int level = 0;
+	while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1))))
+	{
+		++level;
+	}
+	int slot = static_cast<int>((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+	if (delta >= (1ULL << (WHEEL_BITS * WHEEL_LEVELS)))
+	{
+		slot = static_cast<int>(((currentTick >> (WHEEL_BITS * level)) + WHEEL_MASK) & WHEEL_MASK);
+	}
+	t->level = level;
+	t->slot = slot;
+	wheel[level][slot].splice(wheel[level][slot].end(), source, t);
+}
+
+static void removeTimer(boost::unordered_map<TimerKey, TimerList::iterator>::iterator k)
+{
+	TimerList::iterator t = k->second;
+	wheel[t->level][t->slot].erase(t);
+	timers.erase(k);
+	expiryActive = !timers.empty();
+	if (!expiryActive)
+	{
+		writeHooks &= ~WRITE_HOOK_EXPIRY;
+	}
+}
+
+void setExpiry(int id, const std::string &name, int ttl)
+{
+	if (ttl <= 0)
+	{
+		clearExpiry(id, name);
+		return;
+	}
+	if (!expiryActive)
+	{
+		currentTick = getTick();
+		expiryActive = true;
+		writeHooks |= WRITE_HOOK_EXPIRY;
+	}
+	TimerKey key(id, name);
+	boost::unordered_map<TimerKey, TimerList::iterator>::iterator k = timers.find(key);
+	TimerList pending;
+	if (k != timers.end())
+	{
+		TimerList &list = wheel[k->second->level][k->second->slot];
+		pending.splice(pending.end(), list, k->second);
+	}
+	else
+	{
+		Timer timer = { id, name, 0, 0, 0 };
+		pending.push_back(timer);
+		k = timers.insert(std::make_pair(key, pending.begin())).first;
+	}
+	// Ticks are truncated to whole milliseconds, so the deadline is rounded up
+	// by one tick to keep a timer from firing before its TTL has elapsed.
+	k->second->expires = getTick() + static_cast<unsigned long long>(ttl) + 1;
+	placeTimer(pending, k->second);
+}
+
+void clearExpiry(int id, const std::string &name)
+{
+	boost::unordered_map<TimerKey, TimerList::iterator>::iterator k = timers.find(TimerKey(id, name));
+	if (k != timers.end())
+	{
+		removeTimer(k);
+	}
+}
+
+int getExpiry(int id, const std::string &name)
+{
+	boost::unordered_map<TimerKey, TimerList::iterator>::iterator k = timers.find(TimerKey(id, name));
+	if (k == timers.end())
+	{
+		return -1;
+	}
+	unsigned long long now = getTick() + 1;
+	return k->second->expires > now ? static_cast<int>(k->second->expires - now) : 0;
+}
+
+// Entries that have expired since the last tick are deleted when they are
+// next looked up, so they read as missing before the wheel reaches them.
+void expireIfDue(int id, const std::string &name)
+{
+	boost::unordered_map<TimerKey, TimerList::iterator>::iterator k = timers.find(TimerKey(id, name));
+	if (k != timers.end() && k->second->expires <= getTick())
+	{
+		removeTimer(k);
+		deleteGVar(id, name);
+	}
+}
+
+void processExpiry()
+{
+	unsigned long long now = getTick();
+	while (expiryActive && currentTick < now)
+	{
+		++currentTick;
+		for (int level = 1; level < WHEEL_LEVELS; ++level)
+		{
+			if (currentTick & ((1ULL << (WHEEL_BITS * level)) - 1))
+			{
+				break;
+			}
+			TimerList cascade;
+			cascade.swap(wheel[level][(currentTick >> (WHEEL_BITS * level)) & WHEEL_MASK]);
+			while (!cascade.empty())
+			{
+				placeTimer(cascade, cascade.begin());
+			}
+		}
+		TimerList &due = wheel[0][currentTick & WHEEL_MASK];
+		while (!due.empty())
+		{
+			TimerList::iterator t = due.begin();
+			if (t->expires > currentTick)
+			{
+				TimerList later;
+				later.splice(later.end(), due, t);
+				placeTimer(later, later.begin());
+				continue;
+			}
+			int id = t->id;
+			std::string name = t->name;
+			removeTimer(timers.find(TimerKey(id, name)));
+			deleteGVar(id, name);
+		}
+	}
+	if (!expiryActive)
+	{
+		currentTick = now;
+	}
+}
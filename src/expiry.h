@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXPIRY_H
+#define EXPIRY_H
+
+#include "main.h"
+
+#include <string>
+
+extern bool expiryActive;
+
+void setExpiry(int id, const std::string &name, int ttl);
+void clearExpiry(int id, const std::string &name);
+int getExpiry(int id, const std::string &name);
+void expireIfDue(int id, const std::string &name);
+void processExpiry();
+
+#endif
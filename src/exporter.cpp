@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "exporter.h"
+#include "expiry.h"
+#include "main.h"
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/variant.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+	#include <unistd.h>
+#else
+	#include <io.h>
+	#include <windows.h>
+#endif
+
+#define EXPORTER_BUFFER_SIZE (64 * 1024)
+
+// Entries serialized per tick, and the number of serialized bytes that may wait
+// for the writer thread before serializing pauses.
+#define EXPORTER_BATCH_SIZE (4096)
+#define EXPORTER_BACKLOG_LIMIT (4 * 1024 * 1024)
+
+struct ExportBlock
+{
+	ExportBlock(std::string &data, long offset) : offset(offset)
+	{
+		this->data.swap(data);
+	}
+
+	std::string data;
+	long offset;
+};
+
+bool exportPending = false;
+
+static std::atomic<bool> exportRunning(false);
+static std::atomic<std::size_t> exportBacklog(0);
+static std::thread exportThread;
+static std::mutex exportMutex;
+static std::condition_variable exportCondition;
+static std::deque<ExportBlock> exportBlocks;
+static bool exportFinished = false;
+
+// Game thread state. The current ID is walked bucket by bucket, which stays
+// valid between ticks as long as its table is not rehashed.
+static std::vector<int> exportIds;
+static std::size_t exportPosition = 0;
+static std::size_t exportBucket = 0;
+static std::size_t exportBucketCount = 0;
+static long exportOffset = 0;
+static long exportIdOffset = 0;
+
+// Bytes above 0x7F are escaped as \u0080 to \u00ff, so the output is plain
+// ASCII and each byte reads back as the Latin-1 character with that code.
+// SA-MP strings are in the server's code page, which is not known here.
+static void writeString(std::string &output, const std::string &string)
+{
+	output += '"';
+	for (std::string::const_iterator c = string.begin(); c != string.end(); ++c)
+	{
+		unsigned char character = static_cast<unsigned char>(*c);
+		switch (character)
+		{
+			case '"':
+				output += "\\\"";
+				break;
+			case '\\':
+				output += "\\\\";
+				break;
+			case '\n':
+				output += "\\n";
+				break;
+			case '\r':
+				output += "\\r";
+				break;
+			case '\t':
+				output += "\\t";
+				break;
+			default:
+				if (character < 0x20 || character > 0x7F)
+				{
+					char escape[7];
+					std::snprintf(escape, sizeof(escape), "\\u%04x", character);
+					output += escape;
+				}
+				else
+				{
+					output += static_cast<char>(character);
+				}
+				break;
+		}
+	}
+	output += '"';
+}
+
+void writeEntry(std::string &output, int id, const std::string &name, int index, const Value &value)
+{
+	char buffer[64];
+	std::snprintf(buffer, sizeof(buffer), "{\"id\":%d,\"index\":%d,\"name\":", id, index);
+	output += buffer;
+	writeString(output, name);
+	if (value.type() == typeid(int))
+	{
+		std::snprintf(buffer, sizeof(buffer), ",\"type\":\"int\",\"value\":%d}\n", boost::get<int>(value));
+		output += buffer;
+	}
+	else if (value.type() == typeid(std::string))
+	{
+		output += ",\"type\":\"string\",\"value\":";
+		writeString(output, boost::get<std::string>(value));
+		output += "}\n";
+	}
+	else if (value.type() == typeid(float))
+	{
+		float real = boost::get<float>(value);
+		if (std::isfinite(real))
+		{
+			std::snprintf(buffer, sizeof(buffer), ",\"type\":\"float\",\"value\":%.9g}\n", real);
+			output += buffer;
+		}
+		else
+		{
+			output += ",\"type\":\"float\",\"value\":null}\n";
+		}
+	}
+}
+
+// Replaces the export atomically, so readers never see the file missing.
+static void replaceFile(const std::string &source, const std::string &destination)
+{
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+	std::rename(source.c_str(), destination.c_str());
+#else
+	MoveFileExA(source.c_str(), destination.c_str(), MOVEFILE_REPLACE_EXISTING);
+#endif
+}
+
+static bool truncateFile(std::FILE *file, long offset)
+{
+	if (std::fflush(file))
+	{
+		return false;
+	}
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+	if (ftruncate(fileno(file), offset))
+#else
+	if (_chsize_s(_fileno(file), offset))
+#endif
+	{
+		return false;
+	}
+	return !std::fseek(file, offset, SEEK_SET);
+}
+
+// The writer thread only does file I/O. Blocks with an offset cut the file
+// back to where an ID started before that ID is written out again.
+static void writeBlocks(std::FILE *file, std::string path, std::string temporaryPath)
+{
+	char *buffer = new char[EXPORTER_BUFFER_SIZE];
+	std::setvbuf(file, buffer, _IOFBF, EXPORTER_BUFFER_SIZE);
+	bool success = true;
+	std::unique_lock<std::mutex> lock(exportMutex);
+	while (true)
+	{
+		exportCondition.wait(lock, []() { return exportFinished || !exportBlocks.empty(); });
+		if (exportBlocks.empty())
+		{
+			break;
+		}
+		ExportBlock block(exportBlocks.front().data, exportBlocks.front().offset);
+		exportBlocks.pop_front();
+		lock.unlock();
+		if (success)
+		{
+			if (block.offset >= 0)
+			{
+				success = truncateFile(file, block.offset);
+			}
+			else
+			{
+				success = std::fwrite(block.data.data(), 1, block.data.length(), file) == block.data.length();
+			}
+		}
+		exportBacklog -= block.data.length();
+		lock.lock();
+	}
+	lock.unlock();
+	success = !std::ferror(file) && success;
+	success = !std::fclose(file) && success;
+	delete[] buffer;
+	if (success)
+	{
+		replaceFile(temporaryPath, path);
+	}
+	else
+	{
+		std::remove(temporaryPath.c_str());
+	}
+	exportRunning = false;
+}
+
+static void queueBlock(std::string &data, long offset)
+{
+	exportBacklog += data.length();
+	std::lock_guard<std::mutex> lock(exportMutex);
+	exportBlocks.push_back(ExportBlock(data, offset));
+	exportCondition.notify_one();
+}
+
+static void finishExport()
+{
+	std::lock_guard<std::mutex> lock(exportMutex);
+	exportFinished = true;
+	exportPending = false;
+	exportIds.clear();
+	exportCondition.notify_one();
+}
+
+int exportFile(const std::string &path, int id)
+{
+	if (exportRunning)
+	{
+		logprintf("*** ExportGVars: An export is already in progress");
+		return 0;
+	}
+	if (!isScriptFilePath(path))
+	{
+		logprintf("*** ExportGVars: \"%s\" is not a path inside scriptfiles", path.c_str());
+		return 0;
+	}
+	waitForExport();
+	std::string fullPath = "scriptfiles/" + path, temporaryPath = fullPath + ".tmp";
+	std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+	if (!file)
+	{
+		logprintf("*** ExportGVars: Could not open \"%s\"", path.c_str());
+		return 0;
+	}
+	if (id == GLOBAL_VARID_ANY)
+	{
+		exportIds.reserve(mainMap.size());
+		for (MainMap::iterator i = mainMap.begin(); i != mainMap.end(); ++i)
+		{
+			exportIds.push_back(i->first);
+		}
+	}
+	else if (mainMap.find(id) != mainMap.end())
+	{
+		exportIds.push_back(id);
+	}
+	exportPosition = 0;
+	exportBucket = 0;
+	exportOffset = 0;
+	exportIdOffset = 0;
+	exportFinished = false;
+	exportRunning = true;
+	exportPending = true;
+	exportThread = std::thread(writeBlocks, file, fullPath, temporaryPath);
+	return 1;
+}
+
+// Serializes the next batch on the game thread, so no table is shared with
+// another thread and writes never have to copy one. Each GVar is written once,
+// with the value it had when its batch was serialized.
+void processExport()
+{
+	if (exportBacklog > EXPORTER_BACKLOG_LIMIT)
+	{
+		return;
+	}
+	std::string output;
+	std::size_t entries = 0;
+	while (exportPosition < exportIds.size() && entries < EXPORTER_BATCH_SIZE)
+	{
+		int id = exportIds[exportPosition];
+		MainMap::const_iterator i = mainMap.find(id);
+		if (i == mainMap.end())
+		{
+			++exportPosition;
+			exportBucket = 0;
+			continue;
+		}
+		const DataMap &data = *i->second;
+		if (!exportBucket)
+		{
+			exportBucketCount = data.bucket_count();
+			exportIdOffset = exportOffset + static_cast<long>(output.length());
+		}
+		else if (data.bucket_count() != exportBucketCount)
+		{
+			// The table was rehashed since the last batch, so buckets no longer
+			// line up; cut the file back and write this ID again.
+			queueBlock(output, -1);
+			std::string empty;
+			queueBlock(empty, exportIdOffset);
+			exportOffset = exportIdOffset;
+			exportBucket = 0;
+			continue;
+		}
+		while (exportBucket < exportBucketCount && entries < EXPORTER_BATCH_SIZE)
+		{
+			for (DataMap::const_local_iterator j = data.begin(exportBucket); j != data.end(exportBucket); ++j)
+			{
+				writeEntry(output, id, j->first, j->second.get<0>(), j->second.get<1>());
+				++entries;
+			}
+			++exportBucket;
+		}
+		if (exportBucket == exportBucketCount)
+		{
+			++exportPosition;
+			exportBucket = 0;
+		}
+	}
+	exportOffset += static_cast<long>(output.length());
+	if (!output.empty())
+	{
+		queueBlock(output, -1);
+	}
+	if (exportPosition == exportIds.size())
+	{
+		finishExport();
+	}
+}
+
+void waitForExport()
+{
+	while (exportPending)
+	{
+		if (exportBacklog > EXPORTER_BACKLOG_LIMIT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		if (expiryActive)
+		{
+			processExpiry();
+		}
+		processExport();
+	}
+	if (exportThread.joinable())
+	{
+		exportThread.join();
+	}
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "health.h"
+#include "main.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// boost::unordered_map chains entries per bucket, so a successful lookup
+// walks half the chain on average. probes holds the sum of the positions of
+// every entry in its chain, which divided by entries is the mean probe length
+// of a successful lookup.
+static TableHealth measureTable(int id, const DataMap &data)
+{
+	TableHealth health = TableHealth();
+	health.entries = data.size();
+	health.buckets = data.bucket_count();
+	for (std::size_t b = 0; b < health.buckets; ++b)
+	{
+		std::size_t chain = data.bucket_size(b);
+		if (chain)
+		{
+			++health.usedBuckets;
+			health.maxChain = std::max(health.maxChain, chain);
+			health.probes += chain * (chain + 1) / 2;
+		}
+	}
+	IndexMap::iterator k = indexMap.find(id);
+	if (k != indexMap.end())
+	{
+		health.freeIndexes = k->second.get<1>().size();
+		health.upperIndex = k->second.get<0>() + 1;
+	}
+	return health;
+}
+
+static double meanProbes(const TableHealth &health)
+{
+	return health.entries ? static_cast<double>(health.probes) / health.entries : 0.0;
+}
+
+// Expected mean probe length for a successful lookup with a uniform hash at
+// the table's load factor (Knuth, separate chaining).
+static double expectedProbes(const TableHealth &health)
+{
+	return health.buckets ? 1.0 + static_cast<double>(health.entries) / health.buckets / 2.0 : 0.0;
+}
+
+bool getHealth(int id, TableHealth &health)
+{
+	MainMap::iterator i = mainMap.find(id);
+	if (i == mainMap.end())
+	{
+		return false;
+	}
+	health = measureTable(id, *i->second);
+	return true;
+}
+
+void logHealth(int top)
+{
+	std::vector<std::pair<int, TableHealth> > tables;
+	tables.reserve(mainMap.size());
+	TableHealth total = TableHealth();
+	for (MainMap::iterator i = mainMap.begin(); i != mainMap.end(); ++i)
+	{
+		TableHealth health = measureTable(i->first, *i->second);
+		total.entries += health.entries;
+		total.buckets += health.buckets;
+		total.usedBuckets += health.usedBuckets;
+		total.maxChain = std::max(total.maxChain, health.maxChain);
+		total.probes += health.probes;
+		total.freeIndexes += health.freeIndexes;
+		tables.push_back(std::make_pair(i->first, health));
+	}
+	logprintf("*** GVar health: %u IDs in %u buckets (load factor %.2f), %u GVars in %u buckets (%u used, load factor %.2f)", static_cast<unsigned int>(mainMap.size()), static_cast<unsigned int>(mainMap.bucket_count()), mainMap.load_factor(), static_cast<unsigned int>(total.entries), static_cast<unsigned int>(total.buckets), static_cast<unsigned int>(total.usedBuckets), total.buckets ? static_cast<double>(total.entries) / total.buckets : 0.0);
+	logprintf("*** GVar health: %u colliding GVars, mean probe length %.2f (%.2f expected), longest chain %u, %u free indexes", static_cast<unsigned int>(total.entries - total.usedBuckets), meanProbes(total), expectedProbes(total), static_cast<unsigned int>(total.maxChain), static_cast<unsigned int>(total.freeIndexes));
+	std::size_t count = std::min<std::size_t>(tables.size(), std::max(top, 0));
+	std::partial_sort(tables.begin(), tables.begin() + count, tables.end(), [](const std::pair<int, TableHealth> &a, const std::pair<int, TableHealth> &b)
+	{
+		return a.second.entries > b.second.entries;
+	});
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const TableHealth &health = tables[i].second;
+		logprintf("***   ID %d: %u GVars, %u buckets (load factor %.2f), mean probe length %.2f (%.2f expected), longest chain %u, %u of %d indexes free", tables[i].first, static_cast<unsigned int>(health.entries), static_cast<unsigned int>(health.buckets), health.buckets ? static_cast<double>(health.entries) / health.buckets : 0.0, meanProbes(health), expectedProbes(health), static_cast<unsigned int>(health.maxChain), static_cast<unsigned int>(health.freeIndexes), health.upperIndex);
+	}
+}
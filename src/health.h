@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include "main.h"
+
+#include <cstddef>
+
+struct TableHealth
+{
+	std::size_t entries;
+	std::size_t buckets;
+	std::size_t usedBuckets;
+	std::size_t maxChain;
+	std::size_t probes;
+	std::size_t freeIndexes;
+	int upperIndex;
+};
+
+bool getHealth(int id, TableHealth &health);
+void logHealth(int top);
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "loader.h"
+#include "eviction.h"
+#include "expiry.h"
+#include "main.h"
+#include "sharedstore.h"
+
+#include <boost/variant.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Files smaller than this are parsed on the calling thread; anything larger is
+// split into at least this many bytes per worker.
+#define LOADER_CHUNK_SIZE (256 * 1024)
+
+// Upper bound on parser threads; zero uses one per hardware thread.
+unsigned int loaderThreads = 0;
+
+struct Chunk
+{
+	Chunk() : sawSection(false), inherited(0) {}
+
+	std::vector<std::pair<std::string, Value> > entries;
+	std::string lastSection;
+	bool sawSection;
+	std::size_t inherited;
+};
+
+static void trim(const char *&begin, const char *&end)
+{
+	while (begin < end && std::isspace(static_cast<unsigned char>(*begin)))
+	{
+		++begin;
+	}
+	while (end > begin && std::isspace(static_cast<unsigned char>(*(end - 1))))
+	{
+		--end;
+	}
+}
+
+static std::string unquote(const char *begin, const char *end)
+{
+	std::string result;
+	for (const char *p = begin + 1; p < end - 1; ++p)
+	{
+		if (*p == '"' && p + 1 < end - 1 && *(p + 1) == '"')
+		{
+			++p;
+		}
+		result += *p;
+	}
+	return result;
+}
+
+Value inferValue(const char *begin, const char *end)
+{
+	if (end - begin >= 2 && *begin == '"' && *(end - 1) == '"')
+	{
+		return unquote(begin, end);
+	}
+	std::string text(begin, end);
+	if (!text.empty())
+	{
+		char *stop = NULL;
+		errno = 0;
+		long integer = std::strtol(text.c_str(), &stop, 10);
+		if (*stop == '\0' && errno == 0 && integer >= INT_MIN && integer <= INT_MAX)
+		{
+			return static_cast<int>(integer);
+		}
+		if (text.find_first_of("0123456789") != std::string::npos)
+		{
+			float real = std::strtof(text.c_str(), &stop);
+			if (*stop == '\0')
+			{
+				return real;
+			}
+		}
+	}
+	return text;
+}
+
+static const char *findSeparator(const char *begin, const char *end, char separator)
+{
+	bool quoted = false;
+	for (const char *p = begin; p < end; ++p)
+	{
+		if (*p == '"')
+		{
+			quoted = !quoted;
+		}
+		else if (*p == separator && !quoted)
+		{
+			return p;
+		}
+	}
+	return end;
+}
+
+static void parseLine(const char *begin, const char *end, int format, Chunk &chunk)
+{
+	trim(begin, end);
+	if (begin == end || *begin == '#' || *begin == ';')
+	{
+		return;
+	}
+	if (format == GLOBAL_VARFORMAT_INI && *begin == '[' && *(end - 1) == ']')
+	{
+		const char *sectionBegin = begin + 1, *sectionEnd = end - 1;
+		trim(sectionBegin, sectionEnd);
+		chunk.lastSection.assign(sectionBegin, sectionEnd);
+		std::transform(chunk.lastSection.begin(), chunk.lastSection.end(), chunk.lastSection.begin(), ::tolower);
+		if (!chunk.sawSection)
+		{
+			chunk.inherited = chunk.entries.size();
+			chunk.sawSection = true;
+		}
+		return;
+	}
+	const char *separator = findSeparator(begin, end, format == GLOBAL_VARFORMAT_CSV ? ',' : '=');
+	if (separator == end)
+	{
+		return;
+	}
+	const char *nameBegin = begin, *nameEnd = separator, *valueBegin = separator + 1, *valueEnd = end;
+	if (format == GLOBAL_VARFORMAT_CSV)
+	{
+		valueEnd = findSeparator(valueBegin, end, ',');
+	}
+	trim(nameBegin, nameEnd);
+	trim(valueBegin, valueEnd);
+	std::string name;
+	if (nameEnd - nameBegin >= 2 && *nameBegin == '"' && *(nameEnd - 1) == '"')
+	{
+		name = unquote(nameBegin, nameEnd);
+	}
+	else
+	{
+		name.assign(nameBegin, nameEnd);
+	}
+	if (name.empty())
+	{
+		return;
+	}
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+	if (format == GLOBAL_VARFORMAT_INI && chunk.sawSection && !chunk.lastSection.empty())
+	{
+		name = chunk.lastSection + "." + name;
+	}
+	chunk.entries.push_back(std::make_pair(name, inferValue(valueBegin, valueEnd)));
+}
+
+static void parseChunk(const char *begin, const char *end, int format, Chunk *chunk)
+{
+	while (begin < end)
+	{
+		const char *newline = std::find(begin, end, '\n');
+		parseLine(begin, newline, format, *chunk);
+		begin = newline + 1;
+	}
+	if (!chunk->sawSection)
+	{
+		chunk->inherited = chunk->entries.size();
+	}
+}
+
+static int detectFormat(const std::string &path)
+{
+	std::string::size_type dot = path.find_last_of('.');
+	if (dot != std::string::npos)
+	{
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "ini")
+		{
+			return GLOBAL_VARFORMAT_INI;
+		}
+		if (extension == "csv")
+		{
+			return GLOBAL_VARFORMAT_CSV;
+		}
+	}
+	return GLOBAL_VARFORMAT_KEYVALUE;
+}
+
+int loadFile(const std::string &path, int id, int format)
+{
+	if (!isScriptFilePath(path))
+	{
+		logprintf("*** LoadGVarsFromFile: \"%s\" is not a path inside scriptfiles", path.c_str());
+		return 0;
+	}
+	std::ifstream file(("scriptfiles/" + path).c_str(), std::ios::in | std::ios::binary);
+	if (!file)
+	{
+		logprintf("*** LoadGVarsFromFile: Could not open \"%s\"", path.c_str());
+		return 0;
+	}
+	std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (format == GLOBAL_VARFORMAT_AUTO)
+	{
+		format = detectFormat(path);
+	}
+	const char *begin = buffer.empty() ? NULL : &buffer[0], *end = begin + buffer.size();
+	std::size_t workers = std::max<std::size_t>(1, std::min<std::size_t>(loaderThreads ? loaderThreads : std::thread::hardware_concurrency(), buffer.size() / LOADER_CHUNK_SIZE));
+	std::vector<Chunk> chunks(workers);
+	if (workers == 1)
+	{
+		parseChunk(begin, end, format, &chunks[0]);
+	}
+	else
+	{
+		std::vector<std::thread> threads;
+		const char *chunkBegin = begin;
+		for (std::size_t i = 0; i < workers; ++i)
+		{
+			const char *chunkEnd = end;
+			if (i + 1 < workers)
+			{
+				chunkEnd = std::find(std::max(chunkBegin, begin + (buffer.size() / workers) * (i + 1)), end, '\n');
+			}
+			threads.push_back(std::thread(parseChunk, chunkBegin, chunkEnd, format, &chunks[i]));
+			chunkBegin = chunkEnd < end ? chunkEnd + 1 : end;
+		}
+		for (std::size_t i = 0; i < threads.size(); ++i)
+		{
+			threads[i].join();
+		}
+	}
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+	{
+		count += chunks[i].entries.size();
+	}
+	if (!count)
+	{
+		return 0;
+	}
+	std::string section;
+	if (isSharedId(id))
+	{
+		int stored = 0;
+		for (std::size_t i = 0; i < chunks.size(); ++i)
+		{
+			for (std::size_t j = 0; j < chunks[i].entries.size(); ++j)
+			{
+				std::string &name = chunks[i].entries[j].first;
+				if (j < chunks[i].inherited && !section.empty())
+				{
+					name = section + "." + name;
+				}
+				if (setShared(id, name, chunks[i].entries[j].second))
+				{
+					++stored;
+				}
+			}
+			if (chunks[i].sawSection)
+			{
+				section = chunks[i].lastSection;
+			}
+		}
+		return stored;
+	}
+	if (cachesActive)
+	{
+		suspendEviction(true);
+	}
+	DataMap &data = modifyData(mainMap[id]);
+	data.reserve(data.size() + count);
+	for (std::size_t i = 0; i < chunks.size(); ++i)
+	{
+		for (std::size_t j = 0; j < chunks[i].entries.size(); ++j)
+		{
+			std::string &name = chunks[i].entries[j].first;
+			if (j < chunks[i].inherited && !section.empty())
+			{
+				name = section + "." + name;
+			}
+			if (expiryActive)
+			{
+				clearExpiry(id, name);
+			}
+			setData(data, id, name, chunks[i].entries[j].second);
+		}
+		if (chunks[i].sawSection)
+		{
+			section = chunks[i].lastSection;
+		}
+	}
+	if (cachesActive)
+	{
+		suspendEviction(false);
+		enforceCache(id);
+	}
+	return static_cast<int>(count);
+}
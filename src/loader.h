@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "main.h"
+
+#include <string>
+
+extern unsigned int loaderThreads;
+
+Value inferValue(const char *begin, const char *end);
+int loadFile(const std::string &path, int id, int format);
+
+#endif
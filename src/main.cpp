@@ -15,6 +15,25 @@
  */
 
 #include "main.h"
+#include "accounting.h"
+#include "admin.h"
+#include "bindings.h"
+#include "concurrent.h"
+#include "eviction.h"
+#include "exporter.h"
+#include "expiry.h"
+#include "watchers.h"
+#include "health.h"
+#include "loader.h"
+#include "ownership.h"
+#include "profiler.h"
+#include "publisher.h"
+#include "reclaimer.h"
+#include "sharedstore.h"
+#include "slowcalls.h"
+#include "stats.h"
+#include "tasks.h"
+#include "trace.h"
 
 #include <boost/unordered_map.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -23,12 +42,18 @@
 #include <sdk/plugin.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <memory>
 #include <queue>
 #include <string>
 
 IndexMap indexMap;
 MainMap mainMap;
 
+unsigned int storeVersion = 0;
+unsigned int writeHooks = 0;
+
 logprintf_t logprintf;
 
 std::string getString(AMX *amx, cell param, bool toLower)
@@ -47,96 +72,107 @@ std::string getString(AMX *amx, cell param, bool toLower)
 	return name;
 }
 
-PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports()
-{
-	return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES;
-}
-
-PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData)
+// Paths given to natives that open files are relative to scriptfiles, so any
+// path that could leave that directory is refused: ".." components, absolute
+// paths and drive prefixes.
+bool isScriptFilePath(const std::string &path)
 {
-	pAMXFunctions = ppData[PLUGIN_DATA_AMX_EXPORTS];
-	logprintf = (logprintf_t)ppData[PLUGIN_DATA_LOGPRINTF];
-	logprintf("\n\n*** GVar Plugin v%s by Incognito loaded ***\n", PLUGIN_VERSION);
+	if (path.empty() || path[0] == '/' || path[0] == '\\' || path.find(':') != std::string::npos)
+	{
+		return false;
+	}
+	std::string::size_type begin = 0;
+	while (begin <= path.length())
+	{
+		std::string::size_type end = path.find_first_of("/\\", begin);
+		if (end == std::string::npos)
+		{
+			end = path.length();
+		}
+		if (path.compare(begin, end - begin, "..") == 0)
+		{
+			return false;
+		}
+		begin = end + 1;
+	}
 	return true;
 }
 
-PLUGIN_EXPORT void PLUGIN_CALL Unload()
+// Equivalent to amx_SetString for unpacked and packed strings, but reads the
+// stored string directly instead of going through the export table. Strings
+// are stored as bytes, so each character is still widened into its cell; the
+// loops are bounded by size up front so the compiler can vectorize them.
+static void setCellString(cell *dest, const std::string &string, int size)
 {
-	logprintf("\n\n*** GVar Plugin v%s by Incognito unloaded ***\n", PLUGIN_VERSION);
+	if (size <= 0)
+	{
+		return;
+	}
+	std::size_t length = std::min<std::size_t>(string.length(), static_cast<std::size_t>(size) - 1);
+	const char *source = string.data();
+	for (std::size_t i = 0; i < length; ++i)
+	{
+		dest[i] = static_cast<cell>(source[i]);
+	}
+	dest[length] = 0;
 }
 
-static cell AMX_NATIVE_CALL n_SetGVarInt(AMX *amx, cell *params)
+static void setPackedString(cell *dest, const std::string &string, int size)
 {
-	CHECK_PARAMS(3, "SetGVarInt");
-	std::string name = getString(amx, params[1], true);
-	int value = static_cast<int>(params[2]), id = static_cast<int>(params[3]), index = 0;
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	if (size <= 0)
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
-		{
-			j->second = boost::make_tuple(j->second.get<0>(), value);
-			return 1;
-		}
+		return;
 	}
-	IndexMap::iterator k = indexMap.find(id);
-	if (k != indexMap.end())
+	std::size_t length = std::min<std::size_t>(string.length(), static_cast<std::size_t>(size) * sizeof(cell) - 1), cells = length / sizeof(cell);
+	const unsigned char *source = reinterpret_cast<const unsigned char*>(string.data());
+	for (std::size_t i = 0; i < cells; ++i, source += sizeof(cell))
 	{
-		if (!k->second.get<1>().empty())
-		{
-			index = k->second.get<1>().front();
-			k->second.get<1>().pop();
-		}
-		else
-		{
-			index = ++k->second.get<0>();
-		}
+		dest[i] = static_cast<cell>((static_cast<ucell>(source[0]) << 24) | (static_cast<ucell>(source[1]) << 16) | (static_cast<ucell>(source[2]) << 8) | static_cast<ucell>(source[3]));
 	}
-	else
+	ucell last = 0;
+	for (std::size_t i = 0; i < length % sizeof(cell); ++i)
 	{
-		indexMap[id] = boost::make_tuple(0, std::queue<int>());
+		last |= static_cast<ucell>(source[i]) << (24 - i * 8);
 	}
-	mainMap[id][name] = boost::make_tuple(index, value);
-	return 1;
+	dest[cells] = static_cast<cell>(last);
 }
 
-static cell AMX_NATIVE_CALL n_GetGVarInt(AMX *amx, cell *params)
+// Compares a stored string against a Pawn string (packed or unpacked) like
+// strcmp, without first converting the Pawn string to a C string.
+static int compareCellString(const std::string &string, const cell *value, bool ignoreCase)
 {
-	CHECK_PARAMS(2, "GetGVarInt");
-	std::string name = getString(amx, params[1], true);
-	int id = static_cast<int>(params[2]);
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	bool packed = static_cast<ucell>(*value) > UNPACKEDMAX;
+	for (std::size_t i = 0; ; ++i)
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
+		unsigned char given = 0;
+		if (packed)
 		{
-			if (j->second.get<1>().type() == typeid(int))
-			{
-				int value = boost::get<int>(j->second.get<1>());
-				return static_cast<cell>(value);
-			}
+			given = static_cast<unsigned char>(static_cast<ucell>(value[i / sizeof(cell)]) >> ((sizeof(cell) - 1 - i % sizeof(cell)) * 8));
+		}
+		else
+		{
+			given = static_cast<unsigned char>(value[i]);
+		}
+		unsigned char stored = i < string.length() ? static_cast<unsigned char>(string[i]) : 0;
+		if (ignoreCase)
+		{
+			given = static_cast<unsigned char>(::tolower(given));
+			stored = static_cast<unsigned char>(::tolower(stored));
+		}
+		if (given != stored)
+		{
+			return stored < given ? -1 : 1;
+		}
+		if (!stored)
+		{
+			return 0;
 		}
 	}
-	return 0;
 }
 
-static cell AMX_NATIVE_CALL n_SetGVarString(AMX *amx, cell *params)
+int allocateIndex(int id)
 {
-	CHECK_PARAMS(3, "SetGVarString");
-	std::string name = getString(amx, params[1], true), value = getString(amx, params[2], false);
-	int id = static_cast<int>(params[3]), index = 0;
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
-	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
-		{
-			j->second = boost::make_tuple(j->second.get<0>(), value);
-			return 1;
-		}
-	}
+	int index = 0;
 	IndexMap::iterator k = indexMap.find(id);
 	if (k != indexMap.end())
 	{
@@ -144,6 +180,7 @@ static cell AMX_NATIVE_CALL n_SetGVarString(AMX *amx, cell *params)
 		{
 			index = k->second.get<1>().front();
 			k->second.get<1>().pop();
+			trackIndexes(id, -1);
 		}
 		else
 		{
@@ -154,221 +191,1696 @@ static cell AMX_NATIVE_CALL n_SetGVarString(AMX *amx, cell *params)
 	{
 		indexMap[id] = boost::make_tuple(0, std::queue<int>());
 	}
-	mainMap[id][name] = boost::make_tuple(index, value);
-	return 1;
+	return index;
 }
 
-static cell AMX_NATIVE_CALL n_GetGVarString(AMX *amx, cell *params)
+DataMap &modifyData(std::shared_ptr<DataMap> &data)
 {
-	CHECK_PARAMS(4, "GetGVarString");
-	std::string name = getString(amx, params[1], true);
-	int size = static_cast<int>(params[3]), id = static_cast<int>(params[4]);
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	if (!data)
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
-		{
-			if (j->second.get<1>().type() == typeid(std::string))
-			{
-				cell *dest = NULL;
-				amx_GetAddr(amx, params[2], &dest);
-				amx_SetString(dest, boost::get<std::string>(j->second.get<1>()).c_str(), 0, 0, size);
-				return 1;
-			}
-		}
+		data = std::make_shared<DataMap>();
 	}
-	return 0;
+	else if (data.use_count() > 1)
+	{
+		data = std::make_shared<DataMap>(*data);
+		++storeVersion;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return *data;
 }
 
-static cell AMX_NATIVE_CALL n_SetGVarFloat(AMX *amx, cell *params)
+void notifyWrite(int id, const std::string &name, const Value *value)
 {
-	CHECK_PARAMS(3, "SetGVarFloat");
-	std::string name = getString(amx, params[1], true);
-	float value = amx_ctof(params[2]);
-	int id = static_cast<int>(params[3]), index = 0;
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	if (writeHooks & WRITE_HOOK_PUBLISHER)
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
-		{
-			j->second = boost::make_tuple(j->second.get<0>(), value);
-			return 1;
-		}
+		updatePublished(id, name, value);
 	}
-	IndexMap::iterator k = indexMap.find(id);
-	if (k != indexMap.end())
+	if (writeHooks & WRITE_HOOK_CONCURRENT)
 	{
-		if (!k->second.get<1>().empty())
-		{
-			index = k->second.get<1>().front();
-			k->second.get<1>().pop();
-		}
-		else
-		{
-			index = ++k->second.get<0>();
-		}
+		updateConcurrent(id, name, value);
 	}
-	else
+	if (writeHooks & WRITE_HOOK_BINDING)
 	{
-		indexMap[id] = boost::make_tuple(0, std::queue<int>());
+		updateBindings(id, name, value);
+	}
+	if (writeHooks & WRITE_HOOK_WATCH)
+	{
+		recordChange(id, name, value);
+	}
+	if ((writeHooks & WRITE_HOOK_OWNERSHIP) && !value)
+	{
+		releaseGVar(id, name);
+	}
+	if ((writeHooks & WRITE_HOOK_EXPIRY) && !value)
+	{
+		clearExpiry(id, name);
+	}
+	if (writeHooks & WRITE_HOOK_EVICTION)
+	{
+		updateCache(id, name, value);
 	}
-	mainMap[id][name] = boost::make_tuple(index, value);
-	return 1;
 }
 
-static cell AMX_NATIVE_CALL n_GetGVarFloat(AMX *amx, cell *params)
+bool setData(DataMap &data, int id, const std::string &name, const Value &value)
 {
-	CHECK_PARAMS(2, "GetGVarFloat");
-	std::string name = getString(amx, params[1], true);
-	int id = static_cast<int>(params[2]);
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	bool created = false;
+	DataMap::iterator j = data.find(name);
+	if (j != data.end())
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
-		{
-			if (j->second.get<1>().type() == typeid(float))
-			{
-				float value = boost::get<float>(j->second.get<1>());
-				return amx_ftoc(value);
-			}
-		}
+		Value &current = j->second.get<1>();
+		int oldType = getType(current);
+		std::size_t oldBytes = getValueBytes(current);
+		deferValue(current, &value);
+		current = value;
+		trackValue(id, oldType, oldBytes, current);
 	}
-	return 0;
+	else
+	{
+		int index = allocateIndex(id);
+		j = data.insert(std::make_pair(name, boost::make_tuple(index, value))).first;
+		trackEntry(id, j->first, j->second.get<1>(), true);
+		trackBuckets(id, data.bucket_count());
+		created = true;
+	}
+	if (writeHooks)
+	{
+		notifyWrite(id, name, &value);
+	}
+	return created;
 }
 
-static cell AMX_NATIVE_CALL n_DeleteGVar(AMX *amx, cell *params)
+bool setGVar(int id, const std::string &name, const Value &value)
+{
+	return setData(modifyData(mainMap[id]), id, name, value);
+}
+
+bool deleteGVar(int id, const std::string &name)
 {
-	CHECK_PARAMS(2, "DeleteGVar");
-	std::string name = getString(amx, params[1], true);
-	int id = static_cast<int>(params[2]);
 	MainMap::iterator i = mainMap.find(id);
 	if (i != mainMap.end())
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
 		{
 			IndexMap::iterator k = indexMap.find(id);
 			if (k != indexMap.end())
 			{
 				k->second.get<1>().push(j->second.get<0>());
+				trackIndexes(id, 1);
 			}
-			i->second.erase(j);
-			if (i->second.empty())
+			trackEntry(id, j->first, j->second.get<1>(), false);
+			// A snapshot that shares the map keeps the old value alive and may be
+			// reading it on another thread, so only a private map is reclaimed.
+			bool shared = i->second.use_count() > 1;
+			if (i->second->size() == 1)
 			{
-				indexMap.erase(k);
+				if (!shared)
+				{
+					deferValue(j->second.get<1>(), NULL);
+				}
+				if (k != indexMap.end())
+				{
+					deferDestruction(std::make_shared<std::queue<int> >(std::move(k->second.get<1>())));
+					indexMap.erase(k);
+				}
 				mainMap.erase(i);
+				forgetMemory(id);
 			}
-			return 1;
+			else
+			{
+				DataMap &data = modifyData(i->second);
+				if (!shared)
+				{
+					deferValue(j->second.get<1>(), NULL);
+				}
+				data.erase(name);
+			}
+			++storeVersion;
+			if (writeHooks)
+			{
+				notifyWrite(id, name, NULL);
+			}
+			return true;
 		}
 	}
-	return 0;
+	return false;
 }
 
-static cell AMX_NATIVE_CALL n_GetGVarsUpperIndex(AMX *amx, cell *params)
+int deleteGVars(int id)
 {
-	CHECK_PARAMS(1, "GetGVarsUpperIndex");
-	int id = static_cast<int>(params[1]), index = 0;
-	IndexMap::iterator k = indexMap.find(id);
-	if (k != indexMap.end())
+	MainMap::iterator i = mainMap.find(id);
+	if (i == mainMap.end())
 	{
-		if (k->second.get<1>().empty())
-		{
-			index = k->second.get<0>();
-			return static_cast<cell>(index + 1);
-		}
+		return 0;
 	}
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	int count = static_cast<int>(i->second->size());
+	if (writeHooks)
 	{
-		for (DataMap::iterator j = i->second.begin(); j != i->second.end(); ++j)
+		for (DataMap::const_iterator j = i->second->begin(); j != i->second->end(); ++j)
 		{
-			if (j->second.get<0>() > index)
-			{
-				index = j->second.get<0>();
-			}
+			notifyWrite(id, j->first, NULL);
 		}
-		return static_cast<cell>(index + 1);
 	}
-	return 0;
+	deferDestruction(i->second);
+	mainMap.erase(i);
+	forgetMemory(id);
+	IndexMap::iterator k = indexMap.find(id);
+	if (k != indexMap.end())
+	{
+		deferDestruction(std::make_shared<std::queue<int> >(std::move(k->second.get<1>())));
+		indexMap.erase(k);
+	}
+	++storeVersion;
+	return count;
 }
 
-static cell AMX_NATIVE_CALL n_GetGVarNameAtIndex(AMX *amx, cell *params)
+int getType(const Value &value)
 {
-	CHECK_PARAMS(4, "GetGVarNameAtIndex");
-	int index = static_cast<int>(params[1]), size = static_cast<int>(params[3]), id = static_cast<int>(params[4]);
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	if (value.type() == typeid(int))
 	{
-		for (DataMap::iterator j = i->second.begin(); j != i->second.end(); ++j)
-		{
-			if (j->second.get<0>() == index)
-			{
-				cell *dest = NULL;
-				amx_GetAddr(amx, params[2], &dest);
-				amx_SetString(dest, j->first.c_str(), 0, 0, size);
-				return 1;
-			}
-		}
+		return GLOBAL_VARTYPE_INT;
 	}
-	return 0;
+	if (value.type() == typeid(std::string))
+	{
+		return GLOBAL_VARTYPE_STRING;
+	}
+	if (value.type() == typeid(float))
+	{
+		return GLOBAL_VARTYPE_FLOAT;
+	}
+	return GLOBAL_VARTYPE_NONE;
 }
 
-static cell AMX_NATIVE_CALL n_GetGVarType(AMX *amx, cell *params)
+Snapshot takeSnapshot(int id)
 {
-	CHECK_PARAMS(2, "GetGVarType");
-	std::string name = getString(amx, params[1], true);
-	int id = static_cast<int>(params[2]);
-	MainMap::iterator i = mainMap.find(id);
-	if (i != mainMap.end())
+	Snapshot snapshot;
+	if (id == GLOBAL_VARID_ANY)
 	{
-		DataMap::iterator j = i->second.find(name);
-		if (j != i->second.end())
+		snapshot.reserve(mainMap.size());
+		for (MainMap::iterator i = mainMap.begin(); i != mainMap.end(); ++i)
 		{
-			if (j->second.get<1>().type() == typeid(int))
-			{
-				return static_cast<cell>(GLOBAL_VARTYPE_INT);
-			}
-			if (j->second.get<1>().type() == typeid(std::string))
-			{
-				return static_cast<cell>(GLOBAL_VARTYPE_STRING);
-			}
-			if (j->second.get<1>().type() == typeid(float))
-			{
-				return static_cast<cell>(GLOBAL_VARTYPE_FLOAT);
-			}
+			snapshot.push_back(std::make_pair(i->first, std::shared_ptr<const DataMap>(i->second)));
 		}
 	}
-	return static_cast<cell>(GLOBAL_VARTYPE_NONE);
+	else
+	{
+		MainMap::iterator i = mainMap.find(id);
+		if (i != mainMap.end())
+		{
+			snapshot.push_back(std::make_pair(i->first, std::shared_ptr<const DataMap>(i->second)));
+		}
+	}
+	return snapshot;
 }
 
-AMX_NATIVE_INFO natives[] =
+PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports()
 {
-	{ "SetGVarInt", n_SetGVarInt },
-	{ "GetGVarInt", n_GetGVarInt },
-	{ "SetGVarString", n_SetGVarString },
-	{ "GetGVarString", n_GetGVarString },
-	{ "SetGVarFloat", n_SetGVarFloat },
-	{ "GetGVarFloat", n_GetGVarFloat },
-	{ "DeleteGVar", n_DeleteGVar },
-	{ "GetGVarsUpperIndex", n_GetGVarsUpperIndex },
-	{ "GetGVarNameAtIndex", n_GetGVarNameAtIndex },
-	{ "GetGVarType", n_GetGVarType },
-	{ "GetGVarIterator", n_GetGVarIterator },
-	{ "ResetGVarIterator", n_ResetGVarIterator },
-	{ "AdvanceGVarIterator", n_AdvanceGVarIterator },
-	
-	{ 0, 0 }
-};
+	return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES | SUPPORTS_PROCESS_TICK;
+}
 
-PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx)
+PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData)
 {
-	return amx_Register(amx, natives, -1);
+	pAMXFunctions = ppData[PLUGIN_DATA_AMX_EXPORTS];
+	logprintf = (logprintf_t)ppData[PLUGIN_DATA_LOGPRINTF];
+	calibrateStats();
+	logprintf("\n\n*** GVar Plugin v%s by Incognito loaded ***\n", PLUGIN_VERSION);
+	return true;
 }
 
-PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx)
+PLUGIN_EXPORT void PLUGIN_CALL Unload()
+{
+	closeAdmin();
+	waitForExport();
+	closePublisher();
+	closeSharedStore();
+	stopTrace();
+	closeTasks();
+	disableConcurrentReads();
+	closeReclaimer();
+	logprintf("\n\n*** GVar Plugin v%s by Incognito unloaded ***\n", PLUGIN_VERSION);
+}
+
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick()
 {
+	if (adminActive)
+	{
+		processAdmin();
+	}
+	if (concurrentReads)
+	{
+		processConcurrent();
+	}
+	if (tasksPending)
+	{
+		processTasks();
+	}
+	if (reclaimPending)
+	{
+		processReclaimer();
+	}
+	if (expiryActive)
+	{
+		processExpiry();
+	}
+	if (exportPending)
+	{
+		processExport();
+	}
+	if (evictionsPending)
+	{
+		processEvictions();
+	}
+	if (changesPending)
+	{
+		processChanges();
+	}
+	if (statsLogActive)
+	{
+		processStats();
+	}
+	if (slowCallsActive)
+	{
+		processSlowCalls();
+	}
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarInt(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "SetGVarInt");
+	STATS_CALL(TRACE_SETGVARINT);
+	SlowCallTimer slowCall(TRACE_SETGVARINT, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int value = static_cast<int>(params[2]), id = static_cast<int>(params[3]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARINT, id, name, GLOBAL_VARTYPE_INT, value, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		clearExpiry(id, name);
+	}
+	if (isSharedId(id))
+	{
+		return static_cast<cell>(setShared(id, name, value));
+	}
+	if (setGVar(id, name, value) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarInt(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "GetGVarInt");
+	STATS_LOOKUP(TRACE_GETGVARINT);
+	SlowCallTimer slowCall(TRACE_GETGVARINT, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARINT, id, name, GLOBAL_VARTYPE_INT, 0, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	if (isSharedId(id))
+	{
+		Value value;
+		if (getShared(id, name, value) && value.type() == typeid(int))
+		{
+			STATS_FOUND();
+			return static_cast<cell>(boost::get<int>(value));
+		}
+		return 0;
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
+		{
+			if (j->second.get<1>().type() == typeid(int))
+			{
+				STATS_FOUND();
+				int value = boost::get<int>(j->second.get<1>());
+				return static_cast<cell>(value);
+			}
+		}
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarString(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "SetGVarString");
+	STATS_CALL(TRACE_SETGVARSTRING);
+	SlowCallTimer slowCall(TRACE_SETGVARSTRING, amx, params);
+	std::string name = getString(amx, params[1], true), value = getString(amx, params[2], false);
+	int id = static_cast<int>(params[3]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARSTRING, id, name, GLOBAL_VARTYPE_STRING, static_cast<int>(value.length()), 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		clearExpiry(id, name);
+	}
+	if (isSharedId(id))
+	{
+		return static_cast<cell>(setShared(id, name, value));
+	}
+	if (setGVar(id, name, value) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	return 1;
+}
+
+static const std::string *findString(int id, const std::string &name, Value &buffer)
+{
+	if (isSharedId(id))
+	{
+		if (getShared(id, name, buffer) && buffer.type() == typeid(std::string))
+		{
+			return &boost::get<std::string>(buffer);
+		}
+		return NULL;
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
+		{
+			if (j->second.get<1>().type() == typeid(std::string))
+			{
+				return &boost::get<std::string>(j->second.get<1>());
+			}
+		}
+	}
+	return NULL;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarString(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "GetGVarString");
+	STATS_LOOKUP(TRACE_GETGVARSTRING);
+	SlowCallTimer slowCall(TRACE_GETGVARSTRING, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int size = static_cast<int>(params[3]), id = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARSTRING, id, name, GLOBAL_VARTYPE_STRING, size, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	Value buffer;
+	const std::string *value = findString(id, name, buffer);
+	if (value)
+	{
+		STATS_FOUND();
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[2], &dest);
+		setCellString(dest, *value, size);
+		return 1;
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarStringPacked(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "GetGVarStringPacked");
+	STATS_LOOKUP(TRACE_GETGVARSTRINGPACKED);
+	SlowCallTimer slowCall(TRACE_GETGVARSTRINGPACKED, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int size = static_cast<int>(params[3]), id = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARSTRINGPACKED, id, name, GLOBAL_VARTYPE_STRING, size, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	Value buffer;
+	const std::string *value = findString(id, name, buffer);
+	if (value)
+	{
+		STATS_FOUND();
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[2], &dest);
+		setPackedString(dest, *value, size);
+		return 1;
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarStringLength(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "GetGVarStringLength");
+	STATS_LOOKUP(TRACE_GETGVARSTRINGLENGTH);
+	SlowCallTimer slowCall(TRACE_GETGVARSTRINGLENGTH, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARSTRINGLENGTH, id, name, GLOBAL_VARTYPE_STRING, 0, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	Value buffer;
+	const std::string *value = findString(id, name, buffer);
+	if (value)
+	{
+		STATS_FOUND();
+		return static_cast<cell>(value->length());
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarStringSub(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(6, "GetGVarStringSub");
+	STATS_LOOKUP(TRACE_GETGVARSTRINGSUB);
+	SlowCallTimer slowCall(TRACE_GETGVARSTRINGSUB, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int start = static_cast<int>(params[2]), length = static_cast<int>(params[3]), size = static_cast<int>(params[5]), id = static_cast<int>(params[6]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARSTRINGSUB, id, name, GLOBAL_VARTYPE_STRING, length, start);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	Value buffer;
+	const std::string *value = findString(id, name, buffer);
+	if (value && start >= 0)
+	{
+		STATS_FOUND();
+		std::size_t offset = std::min<std::size_t>(start, value->length()), count = value->length() - offset;
+		if (length >= 0)
+		{
+			count = std::min<std::size_t>(count, length);
+		}
+		if (size > 0)
+		{
+			count = std::min<std::size_t>(count, static_cast<std::size_t>(size) - 1);
+			cell *dest = NULL;
+			amx_GetAddr(amx, params[4], &dest);
+			const char *source = value->data() + offset;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				dest[i] = static_cast<cell>(source[i]);
+			}
+			dest[count] = 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_CompareGVarString(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "CompareGVarString");
+	STATS_LOOKUP(TRACE_COMPAREGVARSTRING);
+	SlowCallTimer slowCall(TRACE_COMPAREGVARSTRING, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		cell *string = NULL;
+		int length = 0;
+		amx_GetAddr(amx, params[2], &string);
+		amx_StrLen(string, &length);
+		traceCall(TRACE_COMPAREGVARSTRING, id, name, GLOBAL_VARTYPE_STRING, length, static_cast<int>(params[3]));
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	Value buffer;
+	const std::string *value = findString(id, name, buffer);
+	if (!value)
+	{
+		return GLOBAL_VARCOMPARE_MISSING;
+	}
+	STATS_FOUND();
+	cell *string = NULL;
+	amx_GetAddr(amx, params[2], &string);
+	if (!string)
+	{
+		return 0;
+	}
+	return static_cast<cell>(compareCellString(*value, string, params[3] != 0));
+}
+
+static cell appendString(AMX *amx, int id, const std::string &name, const std::string &value, int maxLength)
+{
+	if (isSharedId(id))
+	{
+		Value current;
+		std::string result;
+		if (getShared(id, name, current))
+		{
+			if (current.type() != typeid(std::string))
+			{
+				return 0;
+			}
+			result = boost::get<std::string>(current);
+		}
+		result.append(value);
+		if (maxLength > 0 && result.length() > static_cast<std::size_t>(maxLength))
+		{
+			result.erase(0, result.length() - maxLength);
+		}
+		return setShared(id, name, result) ? static_cast<cell>(result.length()) : 0;
+	}
+	DataMap &data = modifyData(mainMap[id]);
+	DataMap::iterator j = data.find(name);
+	if (j == data.end())
+	{
+		std::string result = value;
+		if (maxLength > 0 && result.length() > static_cast<std::size_t>(maxLength))
+		{
+			result.erase(0, result.length() - maxLength);
+		}
+		if (setData(data, id, name, result) && ownershipActive)
+		{
+			claimGVar(amx, id, name);
+		}
+		return static_cast<cell>(result.length());
+	}
+	if (j->second.get<1>().type() != typeid(std::string))
+	{
+		return 0;
+	}
+	// std::string grows its buffer geometrically, so appending in place is
+	// amortized O(appended length). Trimming only moves the retained tail.
+	std::string &result = boost::get<std::string>(j->second.get<1>());
+	std::size_t oldBytes = getStringBytes(result);
+	result.append(value);
+	if (maxLength > 0 && result.length() > static_cast<std::size_t>(maxLength))
+	{
+		result.erase(0, result.length() - maxLength);
+	}
+	trackValue(id, GLOBAL_VARTYPE_STRING, oldBytes, j->second.get<1>());
+	cell length = static_cast<cell>(result.length());
+	if (writeHooks)
+	{
+		notifyWrite(id, name, &j->second.get<1>());
+	}
+	return length;
+}
+
+static cell AMX_NATIVE_CALL n_AppendGVarString(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "AppendGVarString");
+	STATS_CALL(TRACE_APPENDGVARSTRING);
+	SlowCallTimer slowCall(TRACE_APPENDGVARSTRING, amx, params);
+	std::string name = getString(amx, params[1], true), value = getString(amx, params[2], false);
+	int id = static_cast<int>(params[3]);
+	if (traceActive)
+	{
+		traceCall(TRACE_APPENDGVARSTRING, id, name, GLOBAL_VARTYPE_STRING, static_cast<int>(value.length()), 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	return appendString(amx, id, name, value, 0);
+}
+
+static cell AMX_NATIVE_CALL n_AppendGVarStringCapped(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "AppendGVarStringCapped");
+	STATS_CALL(TRACE_APPENDGVARSTRINGCAPPED);
+	SlowCallTimer slowCall(TRACE_APPENDGVARSTRINGCAPPED, amx, params);
+	std::string name = getString(amx, params[1], true), value = getString(amx, params[2], false);
+	int maxLength = static_cast<int>(params[3]), id = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_APPENDGVARSTRINGCAPPED, id, name, GLOBAL_VARTYPE_STRING, static_cast<int>(value.length()), maxLength);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (maxLength <= 0)
+	{
+		return 0;
+	}
+	return appendString(amx, id, name, value, maxLength);
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarFloat(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "SetGVarFloat");
+	STATS_CALL(TRACE_SETGVARFLOAT);
+	SlowCallTimer slowCall(TRACE_SETGVARFLOAT, amx, params);
+	std::string name = getString(amx, params[1], true);
+	float value = amx_ctof(params[2]);
+	int id = static_cast<int>(params[3]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARFLOAT, id, name, GLOBAL_VARTYPE_FLOAT, static_cast<int>(params[2]), 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		clearExpiry(id, name);
+	}
+	if (isSharedId(id))
+	{
+		return static_cast<cell>(setShared(id, name, value));
+	}
+	if (setGVar(id, name, value) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarFloat(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "GetGVarFloat");
+	STATS_LOOKUP(TRACE_GETGVARFLOAT);
+	SlowCallTimer slowCall(TRACE_GETGVARFLOAT, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARFLOAT, id, name, GLOBAL_VARTYPE_FLOAT, 0, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	if (isSharedId(id))
+	{
+		Value value;
+		if (getShared(id, name, value) && value.type() == typeid(float))
+		{
+			STATS_FOUND();
+			return amx_ftoc(boost::get<float>(value));
+		}
+		return 0;
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
+		{
+			if (j->second.get<1>().type() == typeid(float))
+			{
+				STATS_FOUND();
+				float value = boost::get<float>(j->second.get<1>());
+				return amx_ftoc(value);
+			}
+		}
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_IncrementGVarInt(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "IncrementGVarInt");
+	STATS_CALL(TRACE_INCREMENTGVARINT);
+	SlowCallTimer slowCall(TRACE_INCREMENTGVARINT, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int amount = static_cast<int>(params[2]), id = static_cast<int>(params[3]), result = 0;
+	if (traceActive)
+	{
+		traceCall(TRACE_INCREMENTGVARINT, id, name, GLOBAL_VARTYPE_INT, amount, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (isSharedId(id))
+	{
+		incrementShared(id, name, amount, result);
+		return static_cast<cell>(result);
+	}
+	DataMap &data = modifyData(mainMap[id]);
+	DataMap::iterator j = data.find(name);
+	if (j != data.end())
+	{
+		if (j->second.get<1>().type() != typeid(int))
+		{
+			return 0;
+		}
+		result = boost::get<int>(j->second.get<1>());
+	}
+	result += amount;
+	if (setData(data, id, name, result) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	return static_cast<cell>(result);
+}
+
+static cell AMX_NATIVE_CALL n_DeleteGVar(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "DeleteGVar");
+	STATS_LOOKUP(TRACE_DELETEGVAR);
+	SlowCallTimer slowCall(TRACE_DELETEGVAR, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (traceActive)
+	{
+		traceCall(TRACE_DELETEGVAR, id, name, GLOBAL_VARTYPE_NONE, 0, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	bool deleted = isSharedId(id) ? deleteShared(id, name) : deleteGVar(id, name);
+	if (deleted)
+	{
+		STATS_FOUND();
+	}
+	return static_cast<cell>(deleted);
+}
+
+static cell AMX_NATIVE_CALL n_DeleteGVars(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "DeleteGVars");
+	STATS_CALL(TRACE_DELETEGVARS);
+	SlowCallTimer slowCall(TRACE_DELETEGVARS, amx, params);
+	int id = static_cast<int>(params[1]), count = 0;
+	if (traceActive)
+	{
+		traceCall(TRACE_DELETEGVARS, id, std::string(), GLOBAL_VARTYPE_NONE, 0, 0);
+	}
+	if (isSharedId(id))
+	{
+		for (int index = getSharedUpperIndex(id) - 1; index >= 0; --index)
+		{
+			std::string name;
+			if (getSharedNameAtIndex(id, index, name) && deleteShared(id, name))
+			{
+				++count;
+			}
+		}
+		return static_cast<cell>(count);
+	}
+	return static_cast<cell>(deleteGVars(id));
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarsUpperIndex(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "GetGVarsUpperIndex");
+	STATS_CALL(TRACE_GETGVARSUPPERINDEX);
+	SlowCallTimer slowCall(TRACE_GETGVARSUPPERINDEX, amx, params);
+	int id = static_cast<int>(params[1]), index = 0;
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARSUPPERINDEX, id, std::string(), GLOBAL_VARTYPE_NONE, 0, 0);
+	}
+	// Catching the timer wheel up deletes every GVar whose TTL has run out, so
+	// enumerations skip them like lookups do.
+	if (expiryActive)
+	{
+		processExpiry();
+	}
+	if (isSharedId(id))
+	{
+		return static_cast<cell>(getSharedUpperIndex(id));
+	}
+	IndexMap::iterator k = indexMap.find(id);
+	if (k != indexMap.end())
+	{
+		if (k->second.get<1>().empty())
+		{
+			index = k->second.get<0>();
+			return static_cast<cell>(index + 1);
+		}
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		for (DataMap::iterator j = i->second->begin(); j != i->second->end(); ++j)
+		{
+			if (j->second.get<0>() > index)
+			{
+				index = j->second.get<0>();
+			}
+		}
+		return static_cast<cell>(index + 1);
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarNameAtIndex(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "GetGVarNameAtIndex");
+	STATS_LOOKUP(TRACE_GETGVARNAMEATINDEX);
+	SlowCallTimer slowCall(TRACE_GETGVARNAMEATINDEX, amx, params);
+	int index = static_cast<int>(params[1]), size = static_cast<int>(params[3]), id = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARNAMEATINDEX, id, std::string(), GLOBAL_VARTYPE_NONE, index, size);
+	}
+	if (expiryActive)
+	{
+		processExpiry();
+	}
+	if (isSharedId(id))
+	{
+		std::string name;
+		if (getSharedNameAtIndex(id, index, name))
+		{
+			cell *dest = NULL;
+			amx_GetAddr(amx, params[2], &dest);
+			amx_SetString(dest, name.c_str(), 0, 0, size);
+			STATS_FOUND();
+			return 1;
+		}
+		return 0;
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		for (DataMap::iterator j = i->second->begin(); j != i->second->end(); ++j)
+		{
+			if (j->second.get<0>() == index)
+			{
+				cell *dest = NULL;
+				amx_GetAddr(amx, params[2], &dest);
+				amx_SetString(dest, j->first.c_str(), 0, 0, size);
+				STATS_FOUND();
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_LoadGVarsFromFile(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "LoadGVarsFromFile");
+	SlowCallTimer slowCall(SLOWCALL_LOADGVARSFROMFILE, amx, params);
+	std::string path = getString(amx, params[1], false);
+	int id = static_cast<int>(params[2]), format = static_cast<int>(params[3]);
+	return static_cast<cell>(loadFile(path, id, format));
+}
+
+static cell AMX_NATIVE_CALL n_ExportGVars(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "ExportGVars");
+	SlowCallTimer slowCall(SLOWCALL_EXPORTGVARS, amx, params);
+	std::string path = getString(amx, params[1], false);
+	int id = static_cast<int>(params[2]);
+	return static_cast<cell>(exportFile(path, id));
+}
+
+static cell AMX_NATIVE_CALL n_OpenGVarSharedMemory(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "OpenGVarSharedMemory");
+	std::string name = getString(amx, params[1], false);
+	int slots = static_cast<int>(params[2]);
+	if (name.empty())
+	{
+		return 0;
+	}
+	return static_cast<cell>(openPublisher(name, slots));
+}
+
+static cell AMX_NATIVE_CALL n_CloseGVarSharedMemory(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(0, "CloseGVarSharedMemory");
+	if (!publisherActive)
+	{
+		return 0;
+	}
+	closePublisher();
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_PublishGVar(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "PublishGVar");
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	return static_cast<cell>(publishGVar(id, name));
+}
+
+static cell AMX_NATIVE_CALL n_UnpublishGVar(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "UnpublishGVar");
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	return static_cast<cell>(unpublishGVar(id, name));
+}
+
+static cell AMX_NATIVE_CALL n_OpenGVarSharedStore(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "OpenGVarSharedStore");
+	std::string name = getString(amx, params[1], false);
+	int lowId = static_cast<int>(params[2]), highId = static_cast<int>(params[3]), capacity = static_cast<int>(params[4]);
+	if (name.empty())
+	{
+		return 0;
+	}
+	return static_cast<cell>(openSharedStore(name, lowId, highId, capacity));
+}
+
+static cell AMX_NATIVE_CALL n_CloseGVarSharedStore(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(0, "CloseGVarSharedStore");
+	if (!sharedStoreActive)
+	{
+		return 0;
+	}
+	closeSharedStore();
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_OpenGVarAdminSocket(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "OpenGVarAdminSocket");
+	std::string path = getString(amx, params[1], false);
+	if (path.empty())
+	{
+		return 0;
+	}
+	return static_cast<cell>(openAdmin(path));
+}
+
+static cell AMX_NATIVE_CALL n_CloseGVarAdminSocket(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(0, "CloseGVarAdminSocket");
+	if (!adminActive)
+	{
+		return 0;
+	}
+	closeAdmin();
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_SortGVarsAsync(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "SortGVarsAsync");
+	int id = static_cast<int>(params[1]), limit = static_cast<int>(params[4]);
+	std::string callback = getString(amx, params[2], false);
+	int task = queueSort(amx, callback, id, params[3] != 0, limit);
+	if (!task)
+	{
+		logprintf("*** SortGVarsAsync: Callback \"%s\" does not exist", callback.c_str());
+	}
+	return static_cast<cell>(task);
+}
+
+static cell AMX_NATIVE_CALL n_FindGVarsAsync(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "FindGVarsAsync");
+	int id = static_cast<int>(params[1]), limit = static_cast<int>(params[4]);
+	std::string pattern = getString(amx, params[2], true), callback = getString(amx, params[3], false);
+	int task = queueFind(amx, callback, id, pattern, limit);
+	if (!task)
+	{
+		logprintf("*** FindGVarsAsync: Callback \"%s\" does not exist", callback.c_str());
+	}
+	return static_cast<cell>(task);
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarAsyncResult(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "GetGVarAsyncResult");
+	int index = static_cast<int>(params[1]), size = static_cast<int>(params[4]), id = 0;
+	std::string name;
+	if (getTaskResult(index, id, name))
+	{
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[2], &dest);
+		*dest = static_cast<cell>(id);
+		amx_GetAddr(amx, params[3], &dest);
+		amx_SetString(dest, name.c_str(), 0, 0, size);
+		return 1;
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_EnableGVarOwnership(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "EnableGVarOwnership");
+	setOwnership(amx, params[1] != 0);
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_BindGVarInt(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "BindGVarInt");
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (isSharedId(id))
+	{
+		logprintf("*** BindGVarInt: GVars in the shared store cannot be bound");
+		return 0;
+	}
+	if (params[3] < 0 || params[3] > amx->hlw - static_cast<cell>(sizeof(cell)) || params[3] % sizeof(cell))
+	{
+		logprintf("*** BindGVarInt: Only global variables can be bound");
+		return 0;
+	}
+	cell *address = NULL;
+	amx_GetAddr(amx, params[3], &address);
+	return static_cast<cell>(bindGVar(amx, id, name, address));
+}
+
+static cell AMX_NATIVE_CALL n_UnbindGVarInt(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "UnbindGVarInt");
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	cell *address = NULL;
+	amx_GetAddr(amx, params[3], &address);
+	return static_cast<cell>(unbindGVar(amx, id, name, address));
+}
+
+static cell AMX_NATIVE_CALL n_StartGVarTrace(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "StartGVarTrace");
+	std::string path = getString(amx, params[1], false);
+	if (path.empty())
+	{
+		return 0;
+	}
+	return static_cast<cell>(startTrace(path));
+}
+
+static cell AMX_NATIVE_CALL n_StopGVarTrace(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(0, "StopGVarTrace");
+	if (!traceActive)
+	{
+		return 0;
+	}
+	stopTrace();
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarStats(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(6, "GetGVarStats");
+	if (!checkStats("GetGVarStats"))
+	{
+		return 0;
+	}
+	std::string native = getString(amx, params[1], false);
+	const NativeStats *stats = getStats(native);
+	if (!stats)
+	{
+		logprintf("*** GetGVarStats: Native \"%s\" is not instrumented", native.c_str());
+		return 0;
+	}
+	unsigned long long values[5] =
+	{
+		stats->calls,
+		stats->hits,
+		stats->misses,
+		stats->calls ? stats->nanoseconds / stats->calls : 0,
+		getStatsPercentile(*stats, 0.99)
+	};
+	for (int i = 0; i < 5; ++i)
+	{
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[i + 2], &dest);
+		*dest = static_cast<cell>(std::min<unsigned long long>(values[i], INT_MAX));
+	}
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarStatsHistogram(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "GetGVarStatsHistogram");
+	if (!checkStats("GetGVarStatsHistogram"))
+	{
+		return 0;
+	}
+	std::string native = getString(amx, params[1], false);
+	const NativeStats *stats = getStats(native);
+	if (!stats)
+	{
+		logprintf("*** GetGVarStatsHistogram: Native \"%s\" is not instrumented", native.c_str());
+		return 0;
+	}
+	int size = std::min(static_cast<int>(params[3]), STATS_BUCKETS);
+	cell *dest = NULL;
+	amx_GetAddr(amx, params[2], &dest);
+	for (int i = 0; i < size; ++i)
+	{
+		dest[i] = static_cast<cell>(std::min<unsigned long long>(stats->buckets[i], INT_MAX));
+	}
+	return static_cast<cell>(std::max(size, 0));
+}
+
+static cell AMX_NATIVE_CALL n_ResetGVarStats(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(0, "ResetGVarStats");
+	if (!checkStats("ResetGVarStats"))
+	{
+		return 0;
+	}
+	resetStats();
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarStatsLogInterval(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "SetGVarStatsLogInterval");
+	if (!checkStats("SetGVarStatsLogInterval"))
+	{
+		return 0;
+	}
+	setStatsInterval(static_cast<int>(params[1]));
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarHealth(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(7, "GetGVarHealth");
+	int id = static_cast<int>(params[1]);
+	TableHealth health;
+	if (isSharedId(id) || !getHealth(id, health))
+	{
+		return 0;
+	}
+	cell values[6] =
+	{
+		static_cast<cell>(health.entries),
+		static_cast<cell>(health.buckets),
+		static_cast<cell>(health.maxChain),
+		0,
+		static_cast<cell>(health.freeIndexes),
+		static_cast<cell>(health.entries - health.usedBuckets)
+	};
+	float probes = health.entries ? static_cast<float>(health.probes) / health.entries : 0.0f;
+	values[3] = amx_ftoc(probes);
+	for (int i = 0; i < 6; ++i)
+	{
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[i + 2], &dest);
+		*dest = values[i];
+	}
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_LogGVarHealth(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "LogGVarHealth");
+	logHealth(static_cast<int>(params[1]));
+	return 1;
+}
+
+static cell setMemoryUsage(AMX *amx, cell *params, const MemoryUsage &usage)
+{
+	std::size_t values[7] =
+	{
+		usage.nodes,
+		usage.keys,
+		usage.strings,
+		usage.indexes,
+		usage.types[GLOBAL_VARTYPE_INT],
+		usage.types[GLOBAL_VARTYPE_STRING],
+		usage.types[GLOBAL_VARTYPE_FLOAT]
+	};
+	for (int i = 0; i < 7; ++i)
+	{
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[i], &dest);
+		*dest = static_cast<cell>(std::min<std::size_t>(values[i], INT_MAX));
+	}
+	return static_cast<cell>(std::min<std::size_t>(getMemoryBytes(usage), INT_MAX));
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarMemoryUsage(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(8, "GetGVarMemoryUsage");
+	int id = static_cast<int>(params[1]);
+	const MemoryUsage *usage = getMemoryUsage(id);
+	if (!usage)
+	{
+		return 0;
+	}
+	return setMemoryUsage(amx, &params[2], *usage);
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarTotalMemoryUsage(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(7, "GetGVarTotalMemoryUsage");
+	return setMemoryUsage(amx, &params[1], totalMemory);
+}
+
+static cell AMX_NATIVE_CALL n_StartGVarProfiler(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "StartGVarProfiler");
+	return static_cast<cell>(startProfiler(static_cast<int>(params[1]), static_cast<int>(params[2])));
+}
+
+static cell AMX_NATIVE_CALL n_StopGVarProfiler(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(0, "StopGVarProfiler");
+	if (!profilerActive)
+	{
+		return 0;
+	}
+	stopProfiler();
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_LogGVarHotKeys(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "LogGVarHotKeys");
+	logHotKeys(static_cast<int>(params[1]));
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarHotKey(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(6, "GetGVarHotKey");
+	int rank = static_cast<int>(params[1]), size = static_cast<int>(params[6]), id = 0;
+	std::string name;
+	unsigned long long count = 0;
+	if (getHotKey(rank, params[2] != 0, id, name, count))
+	{
+		cell *dest = NULL;
+		amx_GetAddr(amx, params[3], &dest);
+		amx_SetString(dest, name.c_str(), 0, 0, size);
+		amx_GetAddr(amx, params[4], &dest);
+		*dest = static_cast<cell>(id);
+		amx_GetAddr(amx, params[5], &dest);
+		*dest = static_cast<cell>(std::min<unsigned long long>(count, INT_MAX));
+		return 1;
+	}
+	return 0;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarSlowCallThreshold(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "SetGVarSlowCallThreshold");
+	setSlowCalls(static_cast<int>(params[1]), static_cast<int>(params[2]));
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarCacheLimit(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(5, "SetGVarCacheLimit");
+	int lowId = static_cast<int>(params[1]), highId = static_cast<int>(params[2]);
+	if (isSharedId(lowId) || isSharedId(highId))
+	{
+		logprintf("*** SetGVarCacheLimit: GVars in the shared store cannot be capped");
+		return 0;
+	}
+	return static_cast<cell>(setCacheLimit(amx, lowId, highId, static_cast<int>(params[3]), static_cast<int>(params[4]), params[5] != 0));
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarIntEx(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "SetGVarIntEx");
+	STATS_CALL(TRACE_SETGVARINTEX);
+	SlowCallTimer slowCall(TRACE_SETGVARINTEX, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int value = static_cast<int>(params[2]), id = static_cast<int>(params[3]), ttl = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARINTEX, id, name, GLOBAL_VARTYPE_INT, value, ttl);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (isSharedId(id))
+	{
+		logprintf("*** SetGVarIntEx: GVars in the shared store cannot expire");
+		return 0;
+	}
+	if (setGVar(id, name, value) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	setExpiry(id, name, ttl);
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarStringEx(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "SetGVarStringEx");
+	STATS_CALL(TRACE_SETGVARSTRINGEX);
+	SlowCallTimer slowCall(TRACE_SETGVARSTRINGEX, amx, params);
+	std::string name = getString(amx, params[1], true), value = getString(amx, params[2], false);
+	int id = static_cast<int>(params[3]), ttl = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARSTRINGEX, id, name, GLOBAL_VARTYPE_STRING, static_cast<int>(value.length()), ttl);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (isSharedId(id))
+	{
+		logprintf("*** SetGVarStringEx: GVars in the shared store cannot expire");
+		return 0;
+	}
+	if (setGVar(id, name, value) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	setExpiry(id, name, ttl);
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarFloatEx(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(4, "SetGVarFloatEx");
+	STATS_CALL(TRACE_SETGVARFLOATEX);
+	SlowCallTimer slowCall(TRACE_SETGVARFLOATEX, amx, params);
+	std::string name = getString(amx, params[1], true);
+	float value = amx_ctof(params[2]);
+	int id = static_cast<int>(params[3]), ttl = static_cast<int>(params[4]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARFLOATEX, id, name, GLOBAL_VARTYPE_FLOAT, static_cast<int>(params[2]), ttl);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (isSharedId(id))
+	{
+		logprintf("*** SetGVarFloatEx: GVars in the shared store cannot expire");
+		return 0;
+	}
+	if (setGVar(id, name, value) && ownershipActive)
+	{
+		claimGVar(amx, id, name);
+	}
+	setExpiry(id, name, ttl);
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_SetGVarTTL(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "SetGVarTTL");
+	STATS_LOOKUP(TRACE_SETGVARTTL);
+	SlowCallTimer slowCall(TRACE_SETGVARTTL, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]), ttl = static_cast<int>(params[3]);
+	if (traceActive)
+	{
+		traceCall(TRACE_SETGVARTTL, id, name, GLOBAL_VARTYPE_NONE, ttl, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, true);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i == mainMap.end() || i->second->find(name) == i->second->end())
+	{
+		return 0;
+	}
+	STATS_FOUND();
+	setExpiry(id, name, ttl);
+	return 1;
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarTTL(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "GetGVarTTL");
+	STATS_CALL(TRACE_GETGVARTTL);
+	SlowCallTimer slowCall(TRACE_GETGVARTTL, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARTTL, id, name, GLOBAL_VARTYPE_NONE, 0, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (!expiryActive)
+	{
+		return -1;
+	}
+	expireIfDue(id, name);
+	return static_cast<cell>(getExpiry(id, name));
+}
+
+static cell AMX_NATIVE_CALL n_WatchGVar(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(3, "WatchGVar");
+	std::string name = getString(amx, params[1], true), callback = getString(amx, params[3], false);
+	int id = static_cast<int>(params[2]);
+	if (id != GLOBAL_VARID_ANY && isSharedId(id))
+	{
+		logprintf("*** WatchGVar: GVars in the shared store cannot be watched");
+		return 0;
+	}
+	int watchId = watchGVar(amx, id, name, callback);
+	if (!watchId)
+	{
+		logprintf("*** WatchGVar: Callback \"%s\" does not exist", callback.c_str());
+	}
+	return static_cast<cell>(watchId);
+}
+
+static cell AMX_NATIVE_CALL n_UnwatchGVar(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(1, "UnwatchGVar");
+	return static_cast<cell>(unwatchGVar(amx, static_cast<int>(params[1])));
+}
+
+static cell AMX_NATIVE_CALL n_GetGVarType(AMX *amx, cell *params)
+{
+	CHECK_PARAMS(2, "GetGVarType");
+	STATS_LOOKUP(TRACE_GETGVARTYPE);
+	SlowCallTimer slowCall(TRACE_GETGVARTYPE, amx, params);
+	std::string name = getString(amx, params[1], true);
+	int id = static_cast<int>(params[2]);
+	if (traceActive)
+	{
+		traceCall(TRACE_GETGVARTYPE, id, name, GLOBAL_VARTYPE_NONE, 0, 0);
+	}
+	if (profilerActive)
+	{
+		profileAccess(id, name, false);
+	}
+	if (expiryActive)
+	{
+		expireIfDue(id, name);
+	}
+	if (cachesActive)
+	{
+		touchCache(id, name);
+	}
+	if (isSharedId(id))
+	{
+		Value value;
+		if (getShared(id, name, value))
+		{
+			STATS_FOUND();
+			return static_cast<cell>(getType(value));
+		}
+		return static_cast<cell>(GLOBAL_VARTYPE_NONE);
+	}
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
+		{
+			STATS_FOUND();
+			return static_cast<cell>(getType(j->second.get<1>()));
+		}
+	}
+	return static_cast<cell>(GLOBAL_VARTYPE_NONE);
+}
+
+AMX_NATIVE_INFO natives[] =
+{
+	{ "SetGVarInt", n_SetGVarInt },
+	{ "GetGVarInt", n_GetGVarInt },
+	{ "SetGVarString", n_SetGVarString },
+	{ "GetGVarString", n_GetGVarString },
+	{ "GetGVarStringPacked", n_GetGVarStringPacked },
+	{ "GetGVarStringLength", n_GetGVarStringLength },
+	{ "GetGVarStringSub", n_GetGVarStringSub },
+	{ "CompareGVarString", n_CompareGVarString },
+	{ "AppendGVarString", n_AppendGVarString },
+	{ "AppendGVarStringCapped", n_AppendGVarStringCapped },
+	{ "SetGVarFloat", n_SetGVarFloat },
+	{ "GetGVarFloat", n_GetGVarFloat },
+	{ "IncrementGVarInt", n_IncrementGVarInt },
+	{ "DeleteGVar", n_DeleteGVar },
+	{ "DeleteGVars", n_DeleteGVars },
+	{ "GetGVarsUpperIndex", n_GetGVarsUpperIndex },
+	{ "GetGVarNameAtIndex", n_GetGVarNameAtIndex },
+	{ "GetGVarType", n_GetGVarType },
+	{ "LoadGVarsFromFile", n_LoadGVarsFromFile },
+	{ "ExportGVars", n_ExportGVars },
+	{ "OpenGVarSharedMemory", n_OpenGVarSharedMemory },
+	{ "CloseGVarSharedMemory", n_CloseGVarSharedMemory },
+	{ "PublishGVar", n_PublishGVar },
+	{ "UnpublishGVar", n_UnpublishGVar },
+	{ "OpenGVarSharedStore", n_OpenGVarSharedStore },
+	{ "CloseGVarSharedStore", n_CloseGVarSharedStore },
+	{ "OpenGVarAdminSocket", n_OpenGVarAdminSocket },
+	{ "CloseGVarAdminSocket", n_CloseGVarAdminSocket },
+	{ "SortGVarsAsync", n_SortGVarsAsync },
+	{ "FindGVarsAsync", n_FindGVarsAsync },
+	{ "GetGVarAsyncResult", n_GetGVarAsyncResult },
+	{ "EnableGVarOwnership", n_EnableGVarOwnership },
+	{ "BindGVarInt", n_BindGVarInt },
+	{ "UnbindGVarInt", n_UnbindGVarInt },
+	{ "StartGVarTrace", n_StartGVarTrace },
+	{ "StopGVarTrace", n_StopGVarTrace },
+	{ "GetGVarStats", n_GetGVarStats },
+	{ "GetGVarStatsHistogram", n_GetGVarStatsHistogram },
+	{ "ResetGVarStats", n_ResetGVarStats },
+	{ "SetGVarStatsLogInterval", n_SetGVarStatsLogInterval },
+	{ "GetGVarHealth", n_GetGVarHealth },
+	{ "LogGVarHealth", n_LogGVarHealth },
+	{ "GetGVarMemoryUsage", n_GetGVarMemoryUsage },
+	{ "GetGVarTotalMemoryUsage", n_GetGVarTotalMemoryUsage },
+	{ "StartGVarProfiler", n_StartGVarProfiler },
+	{ "StopGVarProfiler", n_StopGVarProfiler },
+	{ "LogGVarHotKeys", n_LogGVarHotKeys },
+	{ "GetGVarHotKey", n_GetGVarHotKey },
+	{ "SetGVarSlowCallThreshold", n_SetGVarSlowCallThreshold },
+	{ "SetGVarCacheLimit", n_SetGVarCacheLimit },
+	{ "SetGVarIntEx", n_SetGVarIntEx },
+	{ "SetGVarStringEx", n_SetGVarStringEx },
+	{ "SetGVarFloatEx", n_SetGVarFloatEx },
+	{ "SetGVarTTL", n_SetGVarTTL },
+	{ "GetGVarTTL", n_GetGVarTTL },
+	{ "WatchGVar", n_WatchGVar },
+	{ "UnwatchGVar", n_UnwatchGVar },
+	{ 0, 0 }
+};
+
+PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx)
+{
+	return amx_Register(amx, natives, -1);
+}
+
+PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx)
+{
+	if (tasksPending)
+	{
+		cancelTasks(amx);
+	}
+	if (ownershipActive)
+	{
+		releaseOwner(amx);
+	}
+	if (bindingsActive)
+	{
+		unbindScript(amx);
+	}
+	if (cachesActive)
+	{
+		releaseCaches(amx);
+	}
+	if (watchersActive)
+	{
+		releaseWatches(amx);
+	}
 	return AMX_ERR_NONE;
 }
@@ -24,14 +24,35 @@
 #define GLOBAL_VARTYPE_STRING (2)
 #define GLOBAL_VARTYPE_FLOAT (3)
 
+#define GLOBAL_VARID_ANY (INT_MIN)
+
+#define GLOBAL_VARCOMPARE_MISSING (-2)
+
+#define WRITE_HOOK_PUBLISHER (1)
+#define WRITE_HOOK_CONCURRENT (2)
+#define WRITE_HOOK_OWNERSHIP (4)
+#define WRITE_HOOK_BINDING (8)
+#define WRITE_HOOK_EVICTION (16)
+#define WRITE_HOOK_EXPIRY (32)
+#define WRITE_HOOK_WATCH (64)
+
+#define GLOBAL_VARFORMAT_AUTO (0)
+#define GLOBAL_VARFORMAT_INI (1)
+#define GLOBAL_VARFORMAT_CSV (2)
+#define GLOBAL_VARFORMAT_KEYVALUE (3)
+
 #include <boost/unordered_map.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/variant.hpp>
 
 #include <sdk/plugin.h>
 
+#include <climits>
+#include <memory>
 #include <queue>
 #include <string>
+#include <utility>
+#include <vector>
 
 #define CHECK_PARAMS(m, n) \
 	if (params[0] != (m * 4)) \
@@ -40,14 +61,34 @@
 		return 0; \
 	}
 
-typedef boost::unordered_map<std::string, boost::tuple<int, boost::variant<int, std::string, float> > > DataMap;
+typedef boost::variant<int, std::string, float> Value;
+typedef boost::unordered_map<std::string, boost::tuple<int, Value> > DataMap;
 typedef boost::unordered_map<int, boost::tuple<int, std::queue<int> > > IndexMap;
 typedef boost::unordered_map<std::string, DataMap::iterator> IteratorMap;
-typedef boost::unordered_map<int, DataMap> MainMap;
+typedef boost::unordered_map<int, std::shared_ptr<DataMap> > MainMap;
+typedef std::vector<std::pair<int, std::shared_ptr<const DataMap> > > Snapshot;
 
 typedef void (*logprintf_t)(const char*, ...);
 
+extern IndexMap indexMap;
+extern MainMap mainMap;
+
+extern unsigned int storeVersion;
+extern unsigned int writeHooks;
+
 extern logprintf_t logprintf;
 extern void *pAMXFunctions;
 
+std::string getString(AMX *amx, cell param, bool toLower);
+bool isScriptFilePath(const std::string &path);
+int allocateIndex(int id);
+DataMap &modifyData(std::shared_ptr<DataMap> &data);
+void notifyWrite(int id, const std::string &name, const Value *value);
+bool setData(DataMap &data, int id, const std::string &name, const Value &value);
+bool setGVar(int id, const std::string &name, const Value &value);
+bool deleteGVar(int id, const std::string &name);
+int deleteGVars(int id);
+int getType(const Value &value);
+Snapshot takeSnapshot(int id);
+
 #endif
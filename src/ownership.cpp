@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ownership.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <sdk/plugin.h>
+
+#include <set>
+#include <string>
+#include <utility>
+
+typedef std::pair<int, std::string> OwnedKey;
+typedef std::set<OwnedKey> OwnedSet;
+
+bool ownershipActive = false;
+
+static std::set<AMX*> owningScripts;
+static boost::unordered_map<OwnedKey, AMX*> owners;
+static boost::unordered_map<AMX*, OwnedSet> ownedGVars;
+
+static void updateHook()
+{
+	if (owners.empty())
+	{
+		writeHooks &= ~WRITE_HOOK_OWNERSHIP;
+	}
+	else
+	{
+		writeHooks |= WRITE_HOOK_OWNERSHIP;
+	}
+}
+
+void setOwnership(AMX *amx, bool enabled)
+{
+	if (enabled)
+	{
+		owningScripts.insert(amx);
+	}
+	else
+	{
+		owningScripts.erase(amx);
+	}
+	ownershipActive = !owningScripts.empty() || !owners.empty();
+}
+
+void claimGVar(AMX *amx, int id, const std::string &name)
+{
+	if (owningScripts.find(amx) == owningScripts.end())
+	{
+		return;
+	}
+	OwnedKey key(id, name);
+	if (owners.insert(std::make_pair(key, amx)).second)
+	{
+		ownedGVars[amx].insert(key);
+		updateHook();
+	}
+}
+
+void releaseGVar(int id, const std::string &name)
+{
+	boost::unordered_map<OwnedKey, AMX*>::iterator o = owners.find(OwnedKey(id, name));
+	if (o != owners.end())
+	{
+		boost::unordered_map<AMX*, OwnedSet>::iterator s = ownedGVars.find(o->second);
+		if (s != ownedGVars.end())
+		{
+			s->second.erase(o->first);
+			if (s->second.empty())
+			{
+				ownedGVars.erase(s);
+			}
+		}
+		owners.erase(o);
+		updateHook();
+	}
+}
+
+int releaseOwner(AMX *amx)
+{
+	int count = 0;
+	owningScripts.erase(amx);
+	boost::unordered_map<AMX*, OwnedSet>::iterator s = ownedGVars.find(amx);
+	if (s != ownedGVars.end())
+	{
+		OwnedSet owned;
+		owned.swap(s->second);
+		ownedGVars.erase(s);
+		for (OwnedSet::iterator k = owned.begin(); k != owned.end(); ++k)
+		{
+			owners.erase(*k);
+		}
+		updateHook();
+		for (OwnedSet::iterator k = owned.begin(); k != owned.end(); ++k)
+		{
+			if (deleteGVar(k->first, k->second))
+			{
+				++count;
+			}
+		}
+	}
+	ownershipActive = !owningScripts.empty() || !owners.empty();
+	return count;
+}
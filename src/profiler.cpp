@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "profiler.h"
+#include "main.h"
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Each access kind has a Count-Min sketch of PROFILER_DEPTH rows and a
+// min-heap of the PROFILER_TOP keys with the highest estimates. All counts
+// are halved every PROFILER_DECAY samples so the ranking follows the current
+// workload when the profiler is left running.
+#define PROFILER_DEPTH (4)
+#define PROFILER_WIDTH (2048)
+#define PROFILER_TOP (64)
+#define PROFILER_DECAY (1 << 20)
+
+typedef std::pair<int, std::string> HotKey;
+
+struct HeavyHitters
+{
+	unsigned int sketch[PROFILER_DEPTH][PROFILER_WIDTH];
+	std::vector<std::pair<unsigned int, HotKey> > heap;
+	boost::unordered_map<HotKey, std::size_t> positions;
+};
+
+bool profilerActive = false;
+unsigned int profilerCountdown = 0;
+
+static HeavyHitters hitters[2];
+static unsigned int profilerRate = 0;
+static unsigned int profilerSamples = 0;
+static unsigned int randomState = 0x9e3779b9;
+static int profilerIdRange = 1;
+
+static unsigned int nextCountdown()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return profilerRate > 1 ? profilerRate / 2 + randomState % profilerRate : 1;
+}
+
+static void swapEntries(HeavyHitters &h, std::size_t a, std::size_t b)
+{
+	std::swap(h.heap[a], h.heap[b]);
+	h.positions[h.heap[a].second] = a;
+	h.positions[h.heap[b].second] = b;
+}
+
+static void siftDown(HeavyHitters &h, std::size_t i)
+{
+	while (true)
+	{
+		std::size_t smallest = i, left = 2 * i + 1, right = left + 1;
+		if (left < h.heap.size() && h.heap[left].first < h.heap[smallest].first)
+		{
+			smallest = left;
+		}
+		if (right < h.heap.size() && h.heap[right].first < h.heap[smallest].first)
+		{
+			smallest = right;
+		}
+		if (smallest == i)
+		{
+			return;
+		}
+		swapEntries(h, i, smallest);
+		i = smallest;
+	}
+}
+
+static void siftUp(HeavyHitters &h, std::size_t i)
+{
+	while (i && h.heap[i].first < h.heap[(i - 1) / 2].first)
+	{
+		swapEntries(h, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void resetHitters(HeavyHitters &h)
+{
+	std::fill(&h.sketch[0][0], &h.sketch[0][0] + PROFILER_DEPTH * PROFILER_WIDTH, 0);
+	h.heap.clear();
+	h.positions.clear();
+}
+
+static void decayHitters(HeavyHitters &h)
+{
+	for (unsigned int *c = &h.sketch[0][0]; c != &h.sketch[0][0] + PROFILER_DEPTH * PROFILER_WIDTH; ++c)
+	{
+		*c >>= 1;
+	}
+	for (std::size_t i = 0; i < h.heap.size(); ++i)
+	{
+		h.heap[i].first >>= 1;
+	}
+}
+
+bool startProfiler(int rate, int idRange)
+{
+	if (rate <= 0 || idRange <= 0)
+	{
+		return false;
+	}
+	resetHitters(hitters[0]);
+	resetHitters(hitters[1]);
+	profilerRate = static_cast<unsigned int>(rate);
+	profilerIdRange = idRange;
+	profilerSamples = 0;
+	profilerCountdown = nextCountdown();
+	profilerActive = true;
+	return true;
+}
+
+void stopProfiler()
+{
+	profilerActive = false;
+}
+
+void sampleAccess(int id, const std::string &name, bool write)
+{
+	profilerCountdown = nextCountdown();
+	HeavyHitters &h = hitters[write ? 1 : 0];
+	long long start = id - ((static_cast<long long>(id) % profilerIdRange) + profilerIdRange) % profilerIdRange;
+	HotKey key(static_cast<int>(std::max<long long>(start, INT_MIN)), name);
+	std::size_t hash = boost::hash<HotKey>()(key), step = (hash >> 16) | 1;
+	unsigned int estimate = UINT_MAX;
+	for (int d = 0; d < PROFILER_DEPTH; ++d)
+	{
+		unsigned int &counter = h.sketch[d][(hash + d * step) % PROFILER_WIDTH];
+		if (counter != UINT_MAX)
+		{
+			++counter;
+		}
+		estimate = std::min(estimate, counter);
+	}
+	boost::unordered_map<HotKey, std::size_t>::iterator p = h.positions.find(key);
+	if (p != h.positions.end())
+	{
+		h.heap[p->second].first = estimate;
+		siftDown(h, p->second);
+	}
+	else if (h.heap.size() < PROFILER_TOP)
+	{
+		h.heap.push_back(std::make_pair(estimate, key));
+		h.positions[key] = h.heap.size() - 1;
+		siftUp(h, h.heap.size() - 1);
+	}
+	else if (estimate > h.heap.front().first)
+	{
+		h.positions.erase(h.heap.front().second);
+		h.heap.front() = std::make_pair(estimate, key);
+		h.positions[key] = 0;
+		siftDown(h, 0);
+	}
+	if (++profilerSamples == PROFILER_DECAY)
+	{
+		profilerSamples = 0;
+		decayHitters(hitters[0]);
+		decayHitters(hitters[1]);
+	}
+}
+
+static std::vector<std::pair<unsigned int, HotKey> > rankHitters(const HeavyHitters &h)
+{
+	std::vector<std::pair<unsigned int, HotKey> > ranked(h.heap);
+	std::sort(ranked.begin(), ranked.end(), [](const std::pair<unsigned int, HotKey> &a, const std::pair<unsigned int, HotKey> &b)
+	{
+		return a.first > b.first;
+	});
+	return ranked;
+}
+
+bool getHotKey(int rank, bool write, int &id, std::string &name, unsigned long long &count)
+{
+	const HeavyHitters &h = hitters[write ? 1 : 0];
+	if (rank < 0 || static_cast<std::size_t>(rank) >= h.heap.size())
+	{
+		return false;
+	}
+	std::vector<std::pair<unsigned int, HotKey> > ranked = rankHitters(h);
+	id = ranked[rank].second.first;
+	name = ranked[rank].second.second;
+	count = static_cast<unsigned long long>(ranked[rank].first) * profilerRate;
+	return true;
+}
+
+void logHotKeys(int count)
+{
+	static const char *kinds[2] = { "read", "written" };
+	for (int w = 0; w < 2; ++w)
+	{
+		std::vector<std::pair<unsigned int, HotKey> > ranked = rankHitters(hitters[w]);
+		std::size_t shown = std::min<std::size_t>(ranked.size(), std::max(count, 0));
+		logprintf("*** GVar hot keys: %u most %s (1 in %u calls sampled, IDs grouped by %d)", static_cast<unsigned int>(shown), kinds[w], profilerRate, profilerIdRange);
+		for (std::size_t i = 0; i < shown; ++i)
+		{
+			const HotKey &key = ranked[i].second;
+			if (profilerIdRange > 1)
+			{
+				logprintf("***   %2u. \"%s\" in IDs %d to %d: ~%llu calls", static_cast<unsigned int>(i + 1), key.second.c_str(), key.first, key.first + (profilerIdRange - 1), static_cast<unsigned long long>(ranked[i].first) * profilerRate);
+			}
+			else
+			{
+				logprintf("***   %2u. \"%s\" in ID %d: ~%llu calls", static_cast<unsigned int>(i + 1), key.second.c_str(), key.first, static_cast<unsigned long long>(ranked[i].first) * profilerRate);
+			}
+		}
+	}
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "main.h"
+
+#include <string>
+
+extern bool profilerActive;
+extern unsigned int profilerCountdown;
+
+bool startProfiler(int rate, int idRange);
+void stopProfiler();
+void sampleAccess(int id, const std::string &name, bool write);
+void logHotKeys(int count);
+bool getHotKey(int rank, bool write, int &id, std::string &name, unsigned long long &count);
+
+// Only one call in every profiler rate (on average) reaches the sketch.
+inline void profileAccess(int id, const std::string &name, bool write)
+{
+	if (!--profilerCountdown)
+	{
+		sampleAccess(id, name, write);
+	}
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "publisher.h"
+#include "main.h"
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/variant.hpp>
+
+#include <gvar/shm.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+typedef boost::unordered_map<std::pair<int, std::string>, int> SlotMap;
+
+bool publisherActive = false;
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+
+static gvar_shm_header *segment = NULL;
+static std::size_t segmentSize = 0;
+static std::string segmentName;
+static std::vector<int> freeSlots;
+static std::vector<bool> truncatedSlots;
+static SlotMap slotMap;
+
+static gvar_shm_slot *getSlot(int index)
+{
+	return const_cast<gvar_shm_slot*>(gvar_shm_get_slot(segment, static_cast<uint32_t>(index)));
+}
+
+static void writeSlot(gvar_shm_slot *slot, int id, const std::string &name, const Value *value)
+{
+	uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->id = id;
+	std::strncpy(slot->name, name.c_str(), GVAR_SHM_NAME_SIZE - 1);
+	slot->name[GVAR_SHM_NAME_SIZE - 1] = '\0';
+	slot->length = 0;
+	slot->string[0] = '\0';
+	slot->value.integer = 0;
+	if (!value)
+	{
+		slot->type = GVAR_SHM_TYPE_NONE;
+	}
+	else if (value->type() == typeid(int))
+	{
+		slot->type = GVAR_SHM_TYPE_INT;
+		slot->value.integer = boost::get<int>(*value);
+	}
+	else if (value->type() == typeid(std::string))
+	{
+		const std::string &string = boost::get<std::string>(*value);
+		slot->type = GVAR_SHM_TYPE_STRING;
+		slot->length = static_cast<int32_t>(std::min<std::size_t>(string.length(), GVAR_SHM_STRING_SIZE - 1));
+		std::memcpy(slot->string, string.data(), slot->length);
+		slot->string[slot->length] = '\0';
+	}
+	else if (value->type() == typeid(float))
+	{
+		slot->type = GVAR_SHM_TYPE_FLOAT;
+		slot->value.real = boost::get<float>(*value);
+	}
+	__atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+// A string that does not fit is published truncated; this is logged once each
+// time a GVar's value starts to be truncated.
+static void publishSlot(int index, int id, const std::string &name, const Value *value)
+{
+	bool truncated = value && value->type() == typeid(std::string) && boost::get<std::string>(*value).length() >= GVAR_SHM_STRING_SIZE;
+	if (truncated && !truncatedSlots[index])
+	{
+		logprintf("*** PublishGVar: The value of \"%s\" was truncated to %d characters in shared memory", name.c_str(), GVAR_SHM_STRING_SIZE - 1);
+	}
+	truncatedSlots[index] = truncated;
+	writeSlot(getSlot(index), id, name, value);
+}
+
+bool openPublisher(const std::string &name, int slots)
+{
+	if (segment || slots <= 0)
+	{
+		return false;
+	}
+	segmentName = name[0] == '/' ? name : "/" + name;
+	segmentSize = sizeof(gvar_shm_header) + sizeof(gvar_shm_slot) * static_cast<std::size_t>(slots);
+	int descriptor = shm_open(segmentName.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	if (ftruncate(descriptor, static_cast<off_t>(segmentSize)) < 0)
+	{
+		close(descriptor);
+		shm_unlink(segmentName.c_str());
+		return false;
+	}
+	void *address = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (address == MAP_FAILED)
+	{
+		shm_unlink(segmentName.c_str());
+		return false;
+	}
+	segment = static_cast<gvar_shm_header*>(address);
+	std::memset(segment, 0, segmentSize);
+	segment->version = GVAR_SHM_VERSION;
+	segment->slot_count = static_cast<uint32_t>(slots);
+	segment->slot_size = sizeof(gvar_shm_slot);
+	freeSlots.clear();
+	truncatedSlots.assign(slots, false);
+	for (int i = slots - 1; i >= 0; --i)
+	{
+		freeSlots.push_back(i);
+	}
+	__atomic_store_n(&segment->magic, GVAR_SHM_MAGIC, __ATOMIC_RELEASE);
+	publisherActive = true;
+	writeHooks |= WRITE_HOOK_PUBLISHER;
+	return true;
+}
+
+void closePublisher()
+{
+	if (segment)
+	{
+		munmap(segment, segmentSize);
+		shm_unlink(segmentName.c_str());
+		segment = NULL;
+	}
+	freeSlots.clear();
+	truncatedSlots.clear();
+	slotMap.clear();
+	publisherActive = false;
+	writeHooks &= ~WRITE_HOOK_PUBLISHER;
+}
+
+bool publishGVar(int id, const std::string &name)
+{
+	if (!segment)
+	{
+		return false;
+	}
+	if (name.length() >= GVAR_SHM_NAME_SIZE)
+	{
+		logprintf("*** PublishGVar: Names longer than %d characters cannot be published", GVAR_SHM_NAME_SIZE - 1);
+		return false;
+	}
+	if (slotMap.find(std::make_pair(id, name)) != slotMap.end())
+	{
+		return true;
+	}
+	if (freeSlots.empty())
+	{
+		logprintf("*** PublishGVar: All %u slots are in use", segment->slot_count);
+		return false;
+	}
+	std::pair<SlotMap::iterator, bool> result = slotMap.insert(std::make_pair(std::make_pair(id, name), freeSlots.back()));
+	freeSlots.pop_back();
+	const Value *value = NULL;
+	MainMap::iterator i = mainMap.find(id);
+	if (i != mainMap.end())
+	{
+		DataMap::iterator j = i->second->find(name);
+		if (j != i->second->end())
+		{
+			value = &j->second.get<1>();
+		}
+	}
+	publishSlot(result.first->second, id, name, value);
+	return true;
+}
+
+bool unpublishGVar(int id, const std::string &name)
+{
+	SlotMap::iterator s = slotMap.find(std::make_pair(id, name));
+	if (s == slotMap.end())
+	{
+		return false;
+	}
+	writeSlot(getSlot(s->second), 0, std::string(), NULL);
+	truncatedSlots[s->second] = false;
+	freeSlots.push_back(s->second);
+	slotMap.erase(s);
+	return true;
+}
+
+void updatePublished(int id, const std::string &name, const Value *value)
+{
+	SlotMap::iterator s = slotMap.find(std::make_pair(id, name));
+	if (s != slotMap.end())
+	{
+		publishSlot(s->second, id, name, value);
+	}
+}
+
+#else
+
+bool openPublisher(const std::string &name, int slots)
+{
+	logprintf("*** OpenGVarSharedMemory: Shared memory is not supported on this platform");
+	return false;
+}
+
+void closePublisher()
+{
+}
+
+bool publishGVar(int id, const std::string &name)
+{
+	return false;
+}
+
+bool unpublishGVar(int id, const std::string &name)
+{
+	return false;
+}
+
+void updatePublished(int id, const std::string &name, const Value *value)
+{
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "reclaimer.h"
+#include "main.h"
+
+#include <boost/variant.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define RECLAIMER_STRING_CAPACITY (256)
+
+typedef std::vector<std::shared_ptr<void> > Garbage;
+
+bool reclaimPending = false;
+
+// Objects retired during a tick are collected here without locking and
+// handed to the reclaimer thread in one batch from ProcessTick.
+static Garbage pendingGarbage;
+static Garbage queuedGarbage;
+static std::thread reclaimerThread;
+static std::mutex reclaimerMutex;
+static std::condition_variable reclaimerCondition;
+static bool stopReclaimer = false;
+
+static void runReclaimer()
+{
+	std::unique_lock<std::mutex> lock(reclaimerMutex);
+	while (true)
+	{
+		reclaimerCondition.wait(lock, []() { return stopReclaimer || !queuedGarbage.empty(); });
+		if (queuedGarbage.empty() && stopReclaimer)
+		{
+			return;
+		}
+		Garbage garbage;
+		garbage.swap(queuedGarbage);
+		lock.unlock();
+		garbage.clear();
+		lock.lock();
+	}
+}
+
+void deferDestruction(std::shared_ptr<void> object)
+{
+	pendingGarbage.push_back(std::move(object));
+	reclaimPending = true;
+}
+
+void deferValue(Value &value, const Value *replacement)
+{
+	// Assigning a string that fits into the current buffer reuses it, so only
+	// large strings that would otherwise be freed here are moved out.
+	std::string *string = boost::get<std::string>(&value);
+	if (string && string->capacity() >= RECLAIMER_STRING_CAPACITY)
+	{
+		const std::string *next = replacement ? boost::get<std::string>(replacement) : NULL;
+		if (!next || next->length() > string->capacity())
+		{
+			deferDestruction(std::make_shared<std::string>(std::move(*string)));
+		}
+	}
+}
+
+void processReclaimer()
+{
+	if (!reclaimerThread.joinable())
+	{
+		stopReclaimer = false;
+		reclaimerThread = std::thread(runReclaimer);
+	}
+	{
+		std::lock_guard<std::mutex> lock(reclaimerMutex);
+		if (queuedGarbage.empty())
+		{
+			queuedGarbage.swap(pendingGarbage);
+		}
+		else
+		{
+			queuedGarbage.insert(queuedGarbage.end(), std::make_move_iterator(pendingGarbage.begin()), std::make_move_iterator(pendingGarbage.end()));
+			pendingGarbage.clear();
+		}
+	}
+	reclaimerCondition.notify_one();
+	reclaimPending = false;
+}
+
+void closeReclaimer()
+{
+	if (reclaimerThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(reclaimerMutex);
+			stopReclaimer = true;
+		}
+		reclaimerCondition.notify_one();
+		reclaimerThread.join();
+	}
+	pendingGarbage.clear();
+	reclaimPending = false;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RECLAIMER_H
+#define RECLAIMER_H
+
+#include "main.h"
+
+#include <memory>
+
+extern bool reclaimPending;
+
+void deferDestruction(std::shared_ptr<void> object);
+void deferValue(Value &value, const Value *replacement);
+void processReclaimer();
+void closeReclaimer();
+
+#endif
@@ -0,0 +1,649 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sharedstore.h"
+#include "main.h"
+
+#include <boost/variant.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+	#include <fcntl.h>
+	#include <sched.h>
+	#include <signal.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#define SHARED_STORE_MAGIC (0x53525647)
+#define SHARED_STORE_VERSION (2)
+
+#define SHARED_STORE_NAME_SIZE (32)
+#define SHARED_STORE_STRING_SIZE (128)
+
+#define SHARED_SLOT_EMPTY (0)
+#define SHARED_SLOT_USED (1)
+#define SHARED_SLOT_DELETED (2)
+
+// A waiter checks whether the holder of a lock is still alive every this many
+// yields. A slot lock whose holder has not recorded its process ID yet is only
+// taken over after the timeout.
+#define SHARED_STORE_CHECK_SPINS (256)
+#define SHARED_STORE_LOCK_TIMEOUT (1000)
+
+bool sharedStoreActive = false;
+int sharedLowId = 0;
+int sharedHighId = 0;
+
+#if defined __LINUX__ || defined __FreeBSD__ || defined __OpenBSD__
+
+// Open addressing with tombstones. Keys are only added or removed while the
+// table lock in the header is held, so two processes can never insert the same
+// key twice; values are changed under the slot lock alone. The sequence word
+// of a slot is both its writers' lock (odd while held) and the readers'
+// seqlock, and owner records the process holding it so that a lock left behind
+// by a process that died can be taken over.
+struct SharedSlot
+{
+	uint32_t sequence;
+	int32_t owner;
+	uint32_t state;
+	uint32_t hash;
+	int32_t id;
+	int32_t type;
+	int32_t length;
+	union
+	{
+		int32_t integer;
+		float real;
+	} value;
+	char name[SHARED_STORE_NAME_SIZE];
+	char string[SHARED_STORE_STRING_SIZE];
+};
+
+struct SharedHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t slotSize;
+	int32_t lock;
+	uint32_t reserved[3];
+};
+
+class LockWait
+{
+public:
+	LockWait() : spins(0) {}
+
+	// Yields once, then reports whether the process holding the lock has died.
+	bool ownerDied(int32_t owner)
+	{
+		sched_yield();
+		if (++spins % SHARED_STORE_CHECK_SPINS)
+		{
+			return false;
+		}
+		if (owner)
+		{
+			return kill(static_cast<pid_t>(owner), 0) < 0 && errno == ESRCH;
+		}
+		if (spins == SHARED_STORE_CHECK_SPINS)
+		{
+			start = std::chrono::steady_clock::now();
+		}
+		return std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(SHARED_STORE_LOCK_TIMEOUT);
+	}
+private:
+	unsigned int spins;
+	std::chrono::steady_clock::time_point start;
+};
+
+static SharedHeader *header = NULL;
+static SharedSlot *slots = NULL;
+static std::size_t segmentSize = 0;
+static int32_t processId = 0;
+
+static uint32_t hashKey(int id, const std::string &name)
+{
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < 4; ++i)
+	{
+		hash = (hash ^ ((static_cast<uint32_t>(id) >> (i * 8)) & 0xFF)) * 16777619u;
+	}
+	for (std::string::const_iterator c = name.begin(); c != name.end(); ++c)
+	{
+		hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+	}
+	return hash;
+}
+
+static bool matches(const SharedSlot &slot, uint32_t hash, int id, const std::string &name)
+{
+	return slot.state == SHARED_SLOT_USED && slot.hash == hash && slot.id == id && !std::strncmp(slot.name, name.c_str(), SHARED_STORE_NAME_SIZE);
+}
+
+// Takes over a slot lock held by a process that died. Whatever it was writing
+// may be torn, so the slot becomes a tombstone and its GVar is lost.
+static bool recoverSlot(SharedSlot *slot, uint32_t sequence, int32_t owner)
+{
+	if (!__atomic_compare_exchange_n(&slot->sequence, &sequence, sequence + 2, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		return false;
+	}
+	__atomic_store_n(&slot->owner, processId, __ATOMIC_RELAXED);
+	logprintf("*** GVar shared store: Recovered \"%.*s\" from a lock held by process %d, which no longer exists", SHARED_STORE_NAME_SIZE - 1, slot->name, owner);
+	if (slot->state != SHARED_SLOT_EMPTY)
+	{
+		slot->state = SHARED_SLOT_DELETED;
+	}
+	slot->type = GLOBAL_VARTYPE_NONE;
+	slot->length = 0;
+	return true;
+}
+
+static uint32_t lockSlot(SharedSlot *slot)
+{
+	LockWait wait;
+	while (true)
+	{
+		uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+		if (!(sequence & 1))
+		{
+			if (__atomic_compare_exchange_n(&slot->sequence, &sequence, sequence + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			{
+				__atomic_store_n(&slot->owner, processId, __ATOMIC_RELAXED);
+				return sequence + 1;
+			}
+			continue;
+		}
+		int32_t owner = __atomic_load_n(&slot->owner, __ATOMIC_RELAXED);
+		if (wait.ownerDied(owner) && recoverSlot(slot, sequence, owner))
+		{
+			return sequence + 2;
+		}
+	}
+}
+
+static void unlockSlot(SharedSlot *slot, uint32_t sequence)
+{
+	__atomic_store_n(&slot->owner, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+static void readSlot(SharedSlot *slot, SharedSlot &copy)
+{
+	LockWait wait;
+	uint32_t before, after;
+	while (true)
+	{
+		before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		if (before & 1)
+		{
+			int32_t owner = __atomic_load_n(&slot->owner, __ATOMIC_RELAXED);
+			if (wait.ownerDied(owner) && recoverSlot(slot, before, owner))
+			{
+				unlockSlot(slot, before + 2);
+			}
+			continue;
+		}
+		std::memcpy(&copy, slot, sizeof(copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+		if (before == after)
+		{
+			return;
+		}
+	}
+}
+
+static void lockTable()
+{
+	LockWait wait;
+	while (true)
+	{
+		int32_t owner = 0;
+		if (__atomic_compare_exchange_n(&header->lock, &owner, processId, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			return;
+		}
+		if (owner && wait.ownerDied(owner) && __atomic_compare_exchange_n(&header->lock, &owner, processId, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			logprintf("*** GVar shared store: Recovered the table lock held by process %d, which no longer exists", owner);
+			return;
+		}
+	}
+}
+
+static void unlockTable()
+{
+	__atomic_store_n(&header->lock, 0, __ATOMIC_RELEASE);
+}
+
+static bool validName(const std::string &name)
+{
+	if (name.length() >= SHARED_STORE_NAME_SIZE)
+	{
+		logprintf("*** GVar shared store: \"%s\" is longer than %d characters", name.c_str(), SHARED_STORE_NAME_SIZE - 1);
+		return false;
+	}
+	return !name.empty();
+}
+
+// Lock-free lookup. The slot's key may change as soon as this returns, so
+// writers check it again once they hold the slot lock.
+static SharedSlot *findSlot(int id, const std::string &name, SharedSlot &copy)
+{
+	uint32_t hash = hashKey(id, name), capacity = header->capacity;
+	for (uint32_t probe = 0; probe < capacity; ++probe)
+	{
+		SharedSlot *slot = &slots[(hash + probe) % capacity];
+		readSlot(slot, copy);
+		if (copy.state == SHARED_SLOT_EMPTY)
+		{
+			return NULL;
+		}
+		if (matches(copy, hash, id, name))
+		{
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+// Called with the table lock held, so no other process adds or removes keys.
+// Another process may have added this key since the lock-free lookup, so the
+// whole chain is searched before the first tombstone is reused.
+static SharedSlot *insertSlot(int id, const std::string &name)
+{
+	uint32_t hash = hashKey(id, name), capacity = header->capacity;
+	SharedSlot *target = NULL, copy;
+	for (uint32_t probe = 0; probe < capacity; ++probe)
+	{
+		SharedSlot *slot = &slots[(hash + probe) % capacity];
+		readSlot(slot, copy);
+		if (matches(copy, hash, id, name))
+		{
+			return slot;
+		}
+		if (copy.state != SHARED_SLOT_USED && !target)
+		{
+			target = slot;
+		}
+		if (copy.state == SHARED_SLOT_EMPTY)
+		{
+			break;
+		}
+	}
+	if (target)
+	{
+		uint32_t sequence = lockSlot(target);
+		target->state = SHARED_SLOT_USED;
+		target->hash = hash;
+		target->id = id;
+		target->type = GLOBAL_VARTYPE_NONE;
+		target->length = 0;
+		target->value.integer = 0;
+		std::memcpy(target->name, name.c_str(), name.length() + 1);
+		unlockSlot(target, sequence);
+	}
+	return target;
+}
+
+// Returns the slot holding the key with its lock held, creating the key if
+// requested.
+static SharedSlot *acquireSlot(int id, const std::string &name, bool create, uint32_t &sequence)
+{
+	if (!validName(name))
+	{
+		return NULL;
+	}
+	uint32_t hash = hashKey(id, name);
+	while (true)
+	{
+		SharedSlot copy, *slot = findSlot(id, name, copy);
+		if (!slot)
+		{
+			if (!create)
+			{
+				return NULL;
+			}
+			lockTable();
+			slot = insertSlot(id, name);
+			unlockTable();
+			if (!slot)
+			{
+				logprintf("*** GVar shared store: No free slot for \"%s\" in ID %d (%u slots)", name.c_str(), id, header->capacity);
+				return NULL;
+			}
+		}
+		sequence = lockSlot(slot);
+		if (matches(*slot, hash, id, name))
+		{
+			return slot;
+		}
+		unlockSlot(slot, sequence);
+	}
+}
+
+bool openSharedStore(const std::string &name, int lowId, int highId, int capacity)
+{
+	if (header || capacity <= 0 || lowId > highId)
+	{
+		return false;
+	}
+	std::string segmentName = name[0] == '/' ? name : "/" + name;
+	std::size_t requestedSize = sizeof(SharedHeader) + sizeof(SharedSlot) * static_cast<std::size_t>(capacity);
+	bool created = true;
+	int descriptor = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (descriptor < 0)
+	{
+		created = false;
+		descriptor = shm_open(segmentName.c_str(), O_RDWR, 0644);
+		if (descriptor < 0)
+		{
+			return false;
+		}
+	}
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SHARED_STORE_LOCK_TIMEOUT);
+	struct stat status;
+	if (created)
+	{
+		if (ftruncate(descriptor, static_cast<off_t>(requestedSize)) < 0)
+		{
+			close(descriptor);
+			shm_unlink(segmentName.c_str());
+			return false;
+		}
+		segmentSize = requestedSize;
+	}
+	else
+	{
+		while (true)
+		{
+			if (fstat(descriptor, &status) < 0)
+			{
+				close(descriptor);
+				return false;
+			}
+			if (status.st_size >= static_cast<off_t>(sizeof(SharedHeader)))
+			{
+				break;
+			}
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				logprintf("*** OpenGVarSharedStore: Segment \"%s\" was never initialized", segmentName.c_str());
+				close(descriptor);
+				return false;
+			}
+			sched_yield();
+		}
+		segmentSize = static_cast<std::size_t>(status.st_size);
+	}
+	void *address = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+	header = static_cast<SharedHeader*>(address);
+	slots = reinterpret_cast<SharedSlot*>(header + 1);
+	processId = static_cast<int32_t>(getpid());
+	if (created)
+	{
+		header->version = SHARED_STORE_VERSION;
+		header->capacity = static_cast<uint32_t>(capacity);
+		header->slotSize = sizeof(SharedSlot);
+		__atomic_store_n(&header->magic, SHARED_STORE_MAGIC, __ATOMIC_RELEASE);
+	}
+	else
+	{
+		while (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_STORE_MAGIC)
+		{
+			if (std::chrono::steady_clock::now() >= deadline)
+			{
+				logprintf("*** OpenGVarSharedStore: Segment \"%s\" was never initialized", segmentName.c_str());
+				munmap(address, segmentSize);
+				header = NULL;
+				slots = NULL;
+				return false;
+			}
+			sched_yield();
+		}
+		if (header->version != SHARED_STORE_VERSION || header->slotSize != sizeof(SharedSlot) || sizeof(SharedHeader) + sizeof(SharedSlot) * static_cast<std::size_t>(header->capacity) > segmentSize)
+		{
+			logprintf("*** OpenGVarSharedStore: Segment \"%s\" has an incompatible layout", segmentName.c_str());
+			munmap(address, segmentSize);
+			header = NULL;
+			slots = NULL;
+			return false;
+		}
+	}
+	sharedLowId = lowId;
+	sharedHighId = highId;
+	sharedStoreActive = true;
+	return true;
+}
+
+void closeSharedStore()
+{
+	if (header)
+	{
+		munmap(header, segmentSize);
+		header = NULL;
+		slots = NULL;
+	}
+	sharedStoreActive = false;
+}
+
+bool setShared(int id, const std::string &name, const Value &value)
+{
+	uint32_t sequence = 0;
+	SharedSlot *slot = acquireSlot(id, name, true, sequence);
+	if (!slot)
+	{
+		return false;
+	}
+	slot->length = 0;
+	slot->value.integer = 0;
+	if (value.type() == typeid(int))
+	{
+		slot->type = GLOBAL_VARTYPE_INT;
+		slot->value.integer = boost::get<int>(value);
+	}
+	else if (value.type() == typeid(std::string))
+	{
+		const std::string &string = boost::get<std::string>(value);
+		slot->type = GLOBAL_VARTYPE_STRING;
+		slot->length = static_cast<int32_t>(std::min<std::size_t>(string.length(), SHARED_STORE_STRING_SIZE - 1));
+		std::memcpy(slot->string, string.data(), slot->length);
+		slot->string[slot->length] = '\0';
+	}
+	else if (value.type() == typeid(float))
+	{
+		slot->type = GLOBAL_VARTYPE_FLOAT;
+		slot->value.real = boost::get<float>(value);
+	}
+	unlockSlot(slot, sequence);
+	return true;
+}
+
+bool getShared(int id, const std::string &name, Value &value)
+{
+	SharedSlot copy;
+	if (name.empty() || name.length() >= SHARED_STORE_NAME_SIZE || !findSlot(id, name, copy))
+	{
+		return false;
+	}
+	switch (copy.type)
+	{
+		case GLOBAL_VARTYPE_INT:
+			value = static_cast<int>(copy.value.integer);
+			return true;
+		case GLOBAL_VARTYPE_STRING:
+			value = std::string(copy.string, std::min<std::size_t>(std::max(copy.length, 0), SHARED_STORE_STRING_SIZE - 1));
+			return true;
+		case GLOBAL_VARTYPE_FLOAT:
+			value = copy.value.real;
+			return true;
+	}
+	return false;
+}
+
+// Deleting a key leaves a tombstone for later inserts to reuse. Tombstones
+// directly before an empty slot end no probe chain, so they are emptied.
+bool deleteShared(int id, const std::string &name)
+{
+	if (name.empty() || name.length() >= SHARED_STORE_NAME_SIZE)
+	{
+		return false;
+	}
+	lockTable();
+	uint32_t hash = hashKey(id, name), capacity = header->capacity;
+	SharedSlot copy, *slot = findSlot(id, name, copy);
+	bool existed = false;
+	if (slot)
+	{
+		uint32_t sequence = lockSlot(slot);
+		if (matches(*slot, hash, id, name))
+		{
+			existed = slot->type != GLOBAL_VARTYPE_NONE;
+			slot->state = SHARED_SLOT_DELETED;
+			slot->type = GLOBAL_VARTYPE_NONE;
+			slot->length = 0;
+		}
+		unlockSlot(slot, sequence);
+		uint32_t index = static_cast<uint32_t>(slot - slots);
+		while (slots[index].state == SHARED_SLOT_DELETED && slots[(index + 1) % capacity].state == SHARED_SLOT_EMPTY)
+		{
+			sequence = lockSlot(&slots[index]);
+			slots[index].state = SHARED_SLOT_EMPTY;
+			unlockSlot(&slots[index], sequence);
+			index = (index + capacity - 1) % capacity;
+		}
+	}
+	unlockTable();
+	return existed;
+}
+
+bool incrementShared(int id, const std::string &name, int amount, int &result)
+{
+	uint32_t sequence = 0;
+	SharedSlot *slot = acquireSlot(id, name, true, sequence);
+	if (!slot)
+	{
+		return false;
+	}
+	bool success = true;
+	if (slot->type == GLOBAL_VARTYPE_INT)
+	{
+		slot->value.integer += amount;
+	}
+	else if (slot->type == GLOBAL_VARTYPE_NONE)
+	{
+		slot->type = GLOBAL_VARTYPE_INT;
+		slot->value.integer = amount;
+	}
+	else
+	{
+		success = false;
+	}
+	result = slot->value.integer;
+	unlockSlot(slot, sequence);
+	return success;
+}
+
+// Indexes of the shared store are slot positions, so the upper index is one
+// past the last slot that holds a GVar in the ID.
+int getSharedUpperIndex(int id)
+{
+	SharedSlot copy;
+	for (uint32_t index = header->capacity; index > 0; --index)
+	{
+		readSlot(&slots[index - 1], copy);
+		if (copy.state == SHARED_SLOT_USED && copy.id == id && copy.type != GLOBAL_VARTYPE_NONE)
+		{
+			return static_cast<int>(index);
+		}
+	}
+	return 0;
+}
+
+bool getSharedNameAtIndex(int id, int index, std::string &name)
+{
+	if (index < 0 || index >= static_cast<int>(header->capacity))
+	{
+		return false;
+	}
+	SharedSlot copy;
+	readSlot(&slots[index], copy);
+	if (copy.state != SHARED_SLOT_USED || copy.id != id || copy.type == GLOBAL_VARTYPE_NONE)
+	{
+		return false;
+	}
+	name = std::string(copy.name, strnlen(copy.name, SHARED_STORE_NAME_SIZE));
+	return true;
+}
+
+#else
+
+bool openSharedStore(const std::string &name, int lowId, int highId, int capacity)
+{
+	logprintf("*** OpenGVarSharedStore: Shared memory is not supported on this platform");
+	return false;
+}
+
+void closeSharedStore()
+{
+}
+
+bool setShared(int id, const std::string &name, const Value &value)
+{
+	return false;
+}
+
+bool getShared(int id, const std::string &name, Value &value)
+{
+	return false;
+}
+
+bool deleteShared(int id, const std::string &name)
+{
+	return false;
+}
+
+bool incrementShared(int id, const std::string &name, int amount, int &result)
+{
+	return false;
+}
+
+int getSharedUpperIndex(int id)
+{
+	return 0;
+}
+
+bool getSharedNameAtIndex(int id, int index, std::string &name)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHAREDSTORE_H
+#define SHAREDSTORE_H
+
+#include "main.h"
+
+#include <string>
+
+extern bool sharedStoreActive;
+extern int sharedLowId;
+extern int sharedHighId;
+
+inline bool isSharedId(int id)
+{
+	return sharedStoreActive && id >= sharedLowId && id <= sharedHighId;
+}
+
+bool openSharedStore(const std::string &name, int lowId, int highId, int capacity);
+void closeSharedStore();
+bool setShared(int id, const std::string &name, const Value &value);
+bool getShared(int id, const std::string &name, Value &value);
+bool deleteShared(int id, const std::string &name);
+bool incrementShared(int id, const std::string &name, int amount, int &result);
+int getSharedUpperIndex(int id);
+bool getSharedNameAtIndex(int id, int index, std::string &name);
+
+#endif
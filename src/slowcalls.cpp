@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "slowcalls.h"
+#include "main.h"
+#include "sharedstore.h"
+#include "trace.h"
+
+#include <chrono>
+#include <string>
+
+bool slowCallsActive = false;
+std::chrono::steady_clock::duration slowCallThreshold;
+
+// Positions of the name (or path) and ID parameters of each timed native (0
+// when the native takes no name).
+static const int parameterPositions[SLOWCALL_NATIVES][2] =
+{
+	{ 1, 3 },
+	{ 1, 2 },
+	{ 1, 3 },
+	{ 1, 4 },
+	{ 1, 4 },
+	{ 1, 3 },
+	{ 1, 2 },
+	{ 1, 3 },
+	{ 1, 2 },
+	{ 0, 1 },
+	{ 0, 1 },
+	{ 0, 4 },
+	{ 1, 2 },
+	{ 1, 2 },
+	{ 1, 6 },
+	{ 1, 4 },
+	{ 1, 3 },
+	{ 1, 4 },
+	{ 1, 3 },
+	{ 1, 3 },
+	{ 1, 3 },
+	{ 1, 2 },
+	{ 1, 2 },
+	{ 1, 2 },
+	{ 1, 2 }
+};
+
+static const char *untracedNativeNames[SLOWCALL_NATIVES - TRACE_NATIVES] =
+{
+	"LoadGVarsFromFile",
+	"ExportGVars"
+};
+
+static int logLimit = 0;
+static int loggedCalls = 0;
+static unsigned int suppressedCalls = 0;
+static std::chrono::steady_clock::time_point windowStart;
+
+void setSlowCalls(int threshold, int limit)
+{
+	slowCallsActive = threshold > 0;
+	slowCallThreshold = std::chrono::microseconds(threshold > 0 ? threshold : 0);
+	logLimit = limit > 0 ? limit : 0;
+	loggedCalls = 0;
+	suppressedCalls = 0;
+	windowStart = std::chrono::steady_clock::now();
+}
+
+static void startWindow(std::chrono::steady_clock::time_point now)
+{
+	if (now - windowStart >= std::chrono::minutes(1))
+	{
+		if (suppressedCalls)
+		{
+			logprintf("*** GVar slow calls: %u more calls over %.3f ms were not logged in the last minute", suppressedCalls, std::chrono::duration<double, std::milli>(slowCallThreshold).count());
+		}
+		windowStart = now;
+		loggedCalls = 0;
+		suppressedCalls = 0;
+	}
+}
+
+// At most logLimit calls are logged per minute (all of them when the limit is
+// zero). The number of calls left out is logged from ProcessTick once the
+// minute is over.
+void reportSlowCall(int native, AMX *amx, cell *params, std::chrono::steady_clock::duration elapsed)
+{
+	startWindow(std::chrono::steady_clock::now());
+	if (logLimit && loggedCalls >= logLimit)
+	{
+		++suppressedCalls;
+		return;
+	}
+	++loggedCalls;
+	int id = static_cast<int>(params[parameterPositions[native][1]]);
+	std::string name;
+	if (parameterPositions[native][0])
+	{
+		name = getString(amx, params[parameterPositions[native][0]], native < TRACE_NATIVES);
+	}
+	int entries = 0;
+	if (isSharedId(id))
+	{
+		entries = getSharedUpperIndex(id);
+	}
+	else
+	{
+		MainMap::iterator i = mainMap.find(id);
+		if (i != mainMap.end())
+		{
+			entries = static_cast<int>(i->second->size());
+		}
+	}
+	double milliseconds = std::chrono::duration<double, std::milli>(elapsed).count();
+	const char *nativeName = native < TRACE_NATIVES ? traceNativeNames[native] : untracedNativeNames[native - TRACE_NATIVES];
+	if (parameterPositions[native][0])
+	{
+		logprintf("*** GVar slow call: %s(\"%s\", ID %d) took %.3f ms with %d GVars in the ID", nativeName, name.c_str(), id, milliseconds, entries);
+	}
+	else
+	{
+		logprintf("*** GVar slow call: %s(ID %d) took %.3f ms with %d GVars in the ID", nativeName, id, milliseconds, entries);
+	}
+}
+
+void processSlowCalls()
+{
+	if (suppressedCalls)
+	{
+		startWindow(std::chrono::steady_clock::now());
+	}
+}
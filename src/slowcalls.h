@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SLOWCALLS_H
+#define SLOWCALLS_H
+
+#include "main.h"
+#include "trace.h"
+
+#include <sdk/plugin.h>
+
+#include <chrono>
+
+// Natives that are timed but not traced are numbered after the traced ones.
+enum SlowCallNative
+{
+	SLOWCALL_LOADGVARSFROMFILE = TRACE_NATIVES,
+	SLOWCALL_EXPORTGVARS,
+	SLOWCALL_NATIVES
+};
+
+extern bool slowCallsActive;
+extern std::chrono::steady_clock::duration slowCallThreshold;
+
+void setSlowCalls(int threshold, int limit);
+void reportSlowCall(int native, AMX *amx, cell *params, std::chrono::steady_clock::duration elapsed);
+void processSlowCalls();
+
+// Times a native while slow call logging is enabled. The GVar name and ID are
+// only read back from the parameters when the call was over the threshold.
+class SlowCallTimer
+{
+public:
+	SlowCallTimer(int native, AMX *amx, cell *params) : native(native), amx(amx), params(params), active(slowCallsActive)
+	{
+		if (active)
+		{
+			start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~SlowCallTimer()
+	{
+		if (active)
+		{
+			std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed >= slowCallThreshold)
+			{
+				reportSlowCall(native, amx, params, elapsed);
+			}
+		}
+	}
+private:
+	int native;
+	AMX *amx;
+	cell *params;
+	bool active;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif
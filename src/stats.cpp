@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stats.h"
+#include "main.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+bool statsLogActive = false;
+
+static NativeStats nativeStats[TRACE_NATIVES];
+static unsigned long long loggedCalls[TRACE_NATIVES];
+static std::chrono::steady_clock::duration logInterval;
+static std::chrono::steady_clock::time_point lastLog;
+
+#ifdef GVAR_STATS
+
+#ifdef STATS_TSC
+// The tick rate is measured once when the plugin is loaded, then refined
+// against the time since then every STATS_CALIBRATION_CALLS calls.
+#define STATS_CALIBRATION_CALLS (65536)
+
+static double nanosecondsPerTick = 0.0;
+static unsigned int uncalibratedCalls = 0;
+static unsigned long long baseTicks = 0;
+static std::chrono::steady_clock::time_point baseTime;
+
+static void refineStats()
+{
+	double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - baseTime).count();
+	unsigned long long ticks = readStatsClock() - baseTicks;
+	if (ticks)
+	{
+		nanosecondsPerTick = nanoseconds / ticks;
+	}
+	uncalibratedCalls = 0;
+}
+#endif
+
+void calibrateStats()
+{
+#ifdef STATS_TSC
+	baseTime = std::chrono::steady_clock::now();
+	baseTicks = readStatsClock();
+	while (std::chrono::steady_clock::now() - baseTime < std::chrono::milliseconds(1));
+	refineStats();
+#endif
+}
+
+void recordStats(int native, int result, unsigned long long ticks)
+{
+	NativeStats &stats = nativeStats[native];
+	++stats.calls;
+	if (result == STATS_HIT)
+	{
+		++stats.hits;
+	}
+	else if (result == STATS_MISS)
+	{
+		++stats.misses;
+	}
+#ifdef STATS_TSC
+	if (++uncalibratedCalls >= STATS_CALIBRATION_CALLS)
+	{
+		refineStats();
+	}
+	unsigned long long value = static_cast<unsigned long long>(ticks * nanosecondsPerTick);
+#else
+	unsigned long long value = ticks;
+#endif
+	stats.nanoseconds += value;
+	int bucket = 0;
+	while (value > 1 && bucket < STATS_BUCKETS - 1)
+	{
+		value >>= 1;
+		++bucket;
+	}
+	++stats.buckets[bucket];
+}
+
+bool checkStats(const char *native)
+{
+	return true;
+}
+
+#else
+
+void calibrateStats()
+{
+}
+
+bool checkStats(const char *native)
+{
+	logprintf("*** %s: The plugin was built without GVAR_STATS", native);
+	return false;
+}
+
+#endif
+
+const NativeStats *getStats(const std::string &native)
+{
+	for (int i = 0; i < TRACE_NATIVES; ++i)
+	{
+		if (!std::strcmp(traceNativeNames[i], native.c_str()))
+		{
+			return &nativeStats[i];
+		}
+	}
+	return NULL;
+}
+
+unsigned long long getStatsPercentile(const NativeStats &stats, double fraction)
+{
+	unsigned long long target = static_cast<unsigned long long>(stats.calls * fraction), seen = 0;
+	for (int i = 0; i < STATS_BUCKETS; ++i)
+	{
+		seen += stats.buckets[i];
+		if (seen > target)
+		{
+			return 2ULL << i;
+		}
+	}
+	return 0;
+}
+
+void resetStats()
+{
+	std::memset(nativeStats, 0, sizeof(nativeStats));
+	std::memset(loggedCalls, 0, sizeof(loggedCalls));
+}
+
+void setStatsInterval(int seconds)
+{
+	statsLogActive = seconds > 0;
+	logInterval = std::chrono::seconds(std::max(seconds, 0));
+	lastLog = std::chrono::steady_clock::now();
+	for (int i = 0; i < TRACE_NATIVES; ++i)
+	{
+		loggedCalls[i] = nativeStats[i].calls;
+	}
+}
+
+void processStats()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - lastLog < logInterval)
+	{
+		return;
+	}
+	double seconds = std::chrono::duration<double>(now - lastLog).count();
+	lastLog = now;
+	logprintf("*** GVar stats for the last %.0f seconds:", seconds);
+	for (int i = 0; i < TRACE_NATIVES; ++i)
+	{
+		const NativeStats &stats = nativeStats[i];
+		if (stats.calls == loggedCalls[i])
+		{
+			continue;
+		}
+		char hits[32] = "";
+		if (stats.hits + stats.misses)
+		{
+			std::snprintf(hits, sizeof(hits), ", %.1f%% hits", 100.0 * stats.hits / (stats.hits + stats.misses));
+		}
+		logprintf("***   %s: %llu calls (%.0f/s), %llu total%s, mean %llu ns, p50 < %llu ns, p99 < %llu ns", traceNativeNames[i], stats.calls - loggedCalls[i], (stats.calls - loggedCalls[i]) / seconds, stats.calls, hits, stats.nanoseconds / stats.calls, getStatsPercentile(stats, 0.5), getStatsPercentile(stats, 0.99));
+		loggedCalls[i] = stats.calls;
+	}
+}
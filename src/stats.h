@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "trace.h"
+
+#include <string>
+
+// Latency bucket i counts calls that took [2^i, 2^(i+1)) nanoseconds.
+#define STATS_BUCKETS (32)
+
+#ifdef GVAR_STATS
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define STATS_TSC
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define STATS_TSC
+#endif
+
+#include <chrono>
+
+#define STATS_NONE (-1)
+#define STATS_MISS (0)
+#define STATS_HIT (1)
+
+// Reads the time stamp counter where available, which costs about half as
+// much as steady_clock. Ticks are converted to nanoseconds in recordStats.
+inline unsigned long long readStatsClock()
+{
+#ifdef STATS_TSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void recordStats(int native, int result, unsigned long long ticks);
+
+// Times a native from construction to destruction. Lookups start as misses
+// and are turned into hits with STATS_FOUND() once the GVar has been found.
+class StatsTimer
+{
+public:
+	StatsTimer(int native, int result) : native(native), result(result), start(readStatsClock()) {}
+	~StatsTimer()
+	{
+		recordStats(native, result, readStatsClock() - start);
+	}
+
+	void found()
+	{
+		result = STATS_HIT;
+	}
+private:
+	int native;
+	int result;
+	unsigned long long start;
+};
+
+#define STATS_CALL(native) StatsTimer statsTimer(native, STATS_NONE)
+#define STATS_LOOKUP(native) StatsTimer statsTimer(native, STATS_MISS)
+#define STATS_FOUND() statsTimer.found()
+
+#else
+
+#define STATS_CALL(native) ((void)0)
+#define STATS_LOOKUP(native) ((void)0)
+#define STATS_FOUND() ((void)0)
+
+#endif
+
+struct NativeStats
+{
+	unsigned long long calls;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long nanoseconds;
+	unsigned long long buckets[STATS_BUCKETS];
+};
+
+extern bool statsLogActive;
+
+void calibrateStats();
+bool checkStats(const char *native);
+const NativeStats *getStats(const std::string &native);
+unsigned long long getStatsPercentile(const NativeStats &stats, double fraction);
+void resetStats();
+void setStatsInterval(int seconds);
+void processStats();
+
+#endif
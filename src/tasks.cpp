@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tasks.h"
+#include "expiry.h"
+#include "main.h"
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/variant.hpp>
+
+#include <sdk/plugin.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define TASKS_MAX_WORKERS (4)
+
+// GVars copied out of the store per tick for tasks that are waiting to run.
+#define TASKS_COPY_BATCH (4096)
+
+typedef std::vector<std::pair<int, std::string> > TaskResults;
+
+struct TaskEntry
+{
+	int id;
+	std::string name;
+	Value value;
+};
+
+typedef std::vector<TaskEntry> TaskEntries;
+
+// Workers never see the store. Before a task is queued, the server thread
+// copies the names (and values, if the task needs them) a batch per tick,
+// walking each table bucket by bucket. If a table is rehashed between batches
+// the buckets no longer line up, so that ID is copied again.
+struct Task
+{
+	Task() : id(0), values(false), position(0), bucket(0), bucketCount(0), idStart(0) {}
+
+	int id;
+	bool values;
+	std::vector<int> ids;
+	std::size_t position;
+	std::size_t bucket;
+	std::size_t bucketCount;
+	std::size_t idStart;
+	TaskEntries entries;
+	std::function<void(TaskEntries&, TaskResults&)> work;
+};
+
+bool tasksPending = false;
+
+static std::vector<std::thread> workers;
+static std::mutex taskMutex;
+static std::condition_variable taskCondition;
+static std::deque<Task> copyingTasks;
+static std::deque<Task> queuedTasks;
+static std::deque<std::pair<int, TaskResults> > completedTasks;
+static bool stopWorkers = false;
+
+// Only touched by the server thread.
+static boost::unordered_map<int, std::pair<AMX*, std::string> > callbacks;
+static int nextTaskId = 0;
+static const TaskResults *currentResults = NULL;
+
+static void runWorker()
+{
+	std::unique_lock<std::mutex> lock(taskMutex);
+	while (true)
+	{
+		taskCondition.wait(lock, []() { return stopWorkers || !queuedTasks.empty(); });
+		if (stopWorkers)
+		{
+			return;
+		}
+		Task task = std::move(queuedTasks.front());
+		queuedTasks.pop_front();
+		lock.unlock();
+		TaskResults results;
+		task.work(task.entries, results);
+		task.work = nullptr;
+		TaskEntries().swap(task.entries);
+		lock.lock();
+		completedTasks.push_back(std::make_pair(task.id, std::move(results)));
+	}
+}
+
+static int queueTask(AMX *amx, const std::string &callback, int id, bool values, std::function<void(TaskEntries&, TaskResults&)> work)
+{
+	int index = 0;
+	if (amx_FindPublic(amx, callback.c_str(), &index) != AMX_ERR_NONE)
+	{
+		return 0;
+	}
+	if (workers.empty())
+	{
+		std::size_t count = std::max<std::size_t>(1, std::min<std::size_t>(std::thread::hardware_concurrency(), TASKS_MAX_WORKERS));
+		stopWorkers = false;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			workers.push_back(std::thread(runWorker));
+		}
+	}
+	if (++nextTaskId <= 0)
+	{
+		nextTaskId = 1;
+	}
+	Task task;
+	task.id = nextTaskId;
+	task.values = values;
+	task.work = std::move(work);
+	if (id == GLOBAL_VARID_ANY)
+	{
+		task.ids.reserve(mainMap.size());
+		for (MainMap::iterator i = mainMap.begin(); i != mainMap.end(); ++i)
+		{
+			task.ids.push_back(i->first);
+		}
+	}
+	else if (mainMap.find(id) != mainMap.end())
+	{
+		task.ids.push_back(id);
+	}
+	callbacks[task.id] = std::make_pair(amx, callback);
+	copyingTasks.push_back(std::move(task));
+	tasksPending = true;
+	return nextTaskId;
+}
+
+// Copies up to limit GVars into the task and returns how many were copied.
+static std::size_t copyEntries(Task &task, std::size_t limit)
+{
+	std::size_t copied = 0;
+	while (task.position < task.ids.size() && copied < limit)
+	{
+		int id = task.ids[task.position];
+		MainMap::const_iterator i = mainMap.find(id);
+		if (i == mainMap.end())
+		{
+			++task.position;
+			task.bucket = 0;
+			continue;
+		}
+		const DataMap &data = *i->second;
+		if (!task.bucket)
+		{
+			task.bucketCount = data.bucket_count();
+			task.idStart = task.entries.size();
+		}
+		else if (data.bucket_count() != task.bucketCount)
+		{
+			task.entries.resize(task.idStart);
+			task.bucket = 0;
+			continue;
+		}
+		while (task.bucket < task.bucketCount && copied < limit)
+		{
+			for (DataMap::const_local_iterator j = data.begin(task.bucket); j != data.end(task.bucket); ++j)
+			{
+				TaskEntry entry = { id, j->first, task.values ? j->second.get<1>() : Value() };
+				task.entries.push_back(std::move(entry));
+				++copied;
+			}
+			++task.bucket;
+		}
+		if (task.bucket == task.bucketCount)
+		{
+			++task.position;
+			task.bucket = 0;
+		}
+	}
+	return copied;
+}
+
+static void copyTasks()
+{
+	if (expiryActive)
+	{
+		processExpiry();
+	}
+	std::size_t budget = TASKS_COPY_BATCH;
+	while (!copyingTasks.empty() && budget)
+	{
+		Task &task = copyingTasks.front();
+		if (callbacks.find(task.id) != callbacks.end())
+		{
+			budget -= std::min(budget, copyEntries(task, budget));
+			if (task.position < task.ids.size())
+			{
+				break;
+			}
+			std::vector<int>().swap(task.ids);
+			{
+				std::lock_guard<std::mutex> lock(taskMutex);
+				queuedTasks.push_back(std::move(task));
+			}
+			taskCondition.notify_one();
+		}
+		copyingTasks.pop_front();
+	}
+}
+
+static int compareValues(const Value &first, const Value &second)
+{
+	bool firstString = first.type() == typeid(std::string), secondString = second.type() == typeid(std::string);
+	if (firstString || secondString)
+	{
+		if (firstString && secondString)
+		{
+			return boost::get<std::string>(first).compare(boost::get<std::string>(second));
+		}
+		return firstString ? 1 : -1;
+	}
+	double a = first.type() == typeid(int) ? boost::get<int>(first) : boost::get<float>(first);
+	double b = second.type() == typeid(int) ? boost::get<int>(second) : boost::get<float>(second);
+	return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+static bool matchPattern(const char *pattern, const char *name)
+{
+	const char *star = NULL, *resume = NULL;
+	while (*name)
+	{
+		if (*pattern == '*')
+		{
+			star = pattern++;
+			resume = name;
+		}
+		else if (*pattern == '?' || *pattern == *name)
+		{
+			++pattern;
+			++name;
+		}
+		else if (star)
+		{
+			pattern = star + 1;
+			name = ++resume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	while (*pattern == '*')
+	{
+		++pattern;
+	}
+	return !*pattern;
+}
+
+int queueSort(AMX *amx, const std::string &callback, int id, bool descending, int limit)
+{
+	return queueTask(amx, callback, id, true, [descending, limit](TaskEntries &entries, TaskResults &results)
+	{
+		std::size_t count = limit > 0 ? std::min<std::size_t>(limit, entries.size()) : entries.size();
+		std::partial_sort(entries.begin(), entries.begin() + count, entries.end(), [descending](const TaskEntry &first, const TaskEntry &second)
+		{
+			int result = compareValues(first.value, second.value);
+			if (!result)
+			{
+				return first.id != second.id ? first.id < second.id : first.name < second.name;
+			}
+			return descending ? result > 0 : result < 0;
+		});
+		results.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			results.push_back(std::make_pair(entries[i].id, std::move(entries[i].name)));
+		}
+	});
+}
+
+int queueFind(AMX *amx, const std::string &callback, int id, const std::string &pattern, int limit)
+{
+	return queueTask(amx, callback, id, false, [pattern, limit](TaskEntries &entries, TaskResults &results)
+	{
+		for (TaskEntries::iterator e = entries.begin(); e != entries.end(); ++e)
+		{
+			if (matchPattern(pattern.c_str(), e->name.c_str()))
+			{
+				results.push_back(std::make_pair(e->id, std::move(e->name)));
+				if (limit > 0 && results.size() >= static_cast<std::size_t>(limit))
+				{
+					return;
+				}
+			}
+		}
+	});
+}
+
+bool getTaskResult(int index, int &id, std::string &name)
+{
+	if (!currentResults || index < 0 || static_cast<std::size_t>(index) >= currentResults->size())
+	{
+		return false;
+	}
+	id = (*currentResults)[index].first;
+	name = (*currentResults)[index].second;
+	return true;
+}
+
+void processTasks()
+{
+	if (!copyingTasks.empty())
+	{
+		copyTasks();
+	}
+	std::deque<std::pair<int, TaskResults> > completed;
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		completed.swap(completedTasks);
+	}
+	for (std::deque<std::pair<int, TaskResults> >::iterator c = completed.begin(); c != completed.end(); ++c)
+	{
+		boost::unordered_map<int, std::pair<AMX*, std::string> >::iterator f = callbacks.find(c->first);
+		if (f == callbacks.end())
+		{
+			continue;
+		}
+		AMX *amx = f->second.first;
+		int index = 0;
+		if (amx_FindPublic(amx, f->second.second.c_str(), &index) == AMX_ERR_NONE)
+		{
+			amx_Push(amx, static_cast<cell>(c->second.size()));
+			amx_Push(amx, static_cast<cell>(c->first));
+			currentResults = &c->second;
+			amx_Exec(amx, NULL, index);
+			currentResults = NULL;
+		}
+		callbacks.erase(c->first);
+	}
+	tasksPending = !callbacks.empty();
+}
+
+void cancelTasks(AMX *amx)
+{
+	for (boost::unordered_map<int, std::pair<AMX*, std::string> >::iterator c = callbacks.begin(); c != callbacks.end(); )
+	{
+		if (c->second.first == amx)
+		{
+			c = callbacks.erase(c);
+		}
+		else
+		{
+			++c;
+		}
+	}
+	tasksPending = !callbacks.empty();
+}
+
+void closeTasks()
+{
+	{
+		std::lock_guard<std::mutex> lock(taskMutex);
+		stopWorkers = true;
+	}
+	taskCondition.notify_all();
+	for (std::vector<std::thread>::iterator w = workers.begin(); w != workers.end(); ++w)
+	{
+		w->join();
+	}
+	workers.clear();
+	copyingTasks.clear();
+	queuedTasks.clear();
+	completedTasks.clear();
+	callbacks.clear();
+	tasksPending = false;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "main.h"
+
+#include <sdk/plugin.h>
+
+#include <string>
+
+extern bool tasksPending;
+
+int queueSort(AMX *amx, const std::string &callback, int id, bool descending, int limit);
+int queueFind(AMX *amx, const std::string &callback, int id, const std::string &pattern, int limit);
+bool getTaskResult(int index, int &id, std::string &name);
+void processTasks();
+void cancelTasks(AMX *amx);
+void closeTasks();
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TRACE_BUFFER_SIZE (256 * 1024)
+
+bool traceActive = false;
+
+const char *traceNativeNames[TRACE_NATIVES] =
+{
+	"SetGVarInt",
+	"GetGVarInt",
+	"SetGVarString",
+	"GetGVarString",
+	"GetGVarStringPacked",
+	"SetGVarFloat",
+	"GetGVarFloat",
+	"IncrementGVarInt",
+	"DeleteGVar",
+	"DeleteGVars",
+	"GetGVarsUpperIndex",
+	"GetGVarNameAtIndex",
+	"GetGVarType",
+	"GetGVarStringLength",
+	"GetGVarStringSub",
+	"CompareGVarString",
+	"AppendGVarString",
+	"AppendGVarStringCapped",
+	"SetGVarIntEx",
+	"SetGVarStringEx",
+	"SetGVarFloatEx",
+	"SetGVarTTL",
+	"GetGVarTTL"
+};
+
+// Records are encoded into traceBuffer on the server thread. Full buffers
+// are handed to a writer thread so the file I/O never happens in a native.
+static std::vector<unsigned char> traceBuffer;
+static std::vector<std::vector<unsigned char> > writeQueue;
+static boost::unordered_map<std::string, unsigned int> traceNames;
+static std::chrono::steady_clock::time_point lastCall;
+static std::FILE *traceFile = NULL;
+static std::thread writerThread;
+static std::mutex writerMutex;
+static std::condition_variable writerCondition;
+static bool stopWriter = false;
+
+static void runWriter()
+{
+	std::unique_lock<std::mutex> lock(writerMutex);
+	while (true)
+	{
+		writerCondition.wait(lock, []() { return stopWriter || !writeQueue.empty(); });
+		std::vector<std::vector<unsigned char> > buffers;
+		buffers.swap(writeQueue);
+		lock.unlock();
+		for (std::vector<std::vector<unsigned char> >::iterator b = buffers.begin(); b != buffers.end(); ++b)
+		{
+			std::fwrite(&(*b)[0], 1, b->size(), traceFile);
+		}
+		lock.lock();
+		if (stopWriter && writeQueue.empty())
+		{
+			return;
+		}
+	}
+}
+
+static void flushBuffer()
+{
+	if (traceBuffer.empty())
+	{
+		return;
+	}
+	std::vector<unsigned char> buffer;
+	buffer.reserve(TRACE_BUFFER_SIZE + 64);
+	buffer.swap(traceBuffer);
+	{
+		std::lock_guard<std::mutex> lock(writerMutex);
+		writeQueue.push_back(std::move(buffer));
+	}
+	writerCondition.notify_one();
+}
+
+static void writeVarint(unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		traceBuffer.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	traceBuffer.push_back(static_cast<unsigned char>(value));
+}
+
+static void writeSigned(int value)
+{
+	writeVarint((static_cast<unsigned int>(value) << 1) ^ static_cast<unsigned int>(value >> 31));
+}
+
+static void writeWord(std::uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		traceBuffer.push_back(static_cast<unsigned char>(value >> (i * 8)));
+	}
+}
+
+bool startTrace(const std::string &path)
+{
+	if (traceActive)
+	{
+		logprintf("*** StartGVarTrace: A trace is already being recorded");
+		return false;
+	}
+	traceFile = std::fopen(("scriptfiles/" + path).c_str(), "wb");
+	if (!traceFile)
+	{
+		logprintf("*** StartGVarTrace: Could not open \"%s\"", path.c_str());
+		return false;
+	}
+	traceBuffer.clear();
+	traceBuffer.reserve(TRACE_BUFFER_SIZE + 64);
+	traceNames.clear();
+	writeWord(TRACE_MAGIC);
+	writeWord(TRACE_VERSION);
+	lastCall = std::chrono::steady_clock::now();
+	stopWriter = false;
+	writerThread = std::thread(runWriter);
+	traceActive = true;
+	return true;
+}
+
+void stopTrace()
+{
+	if (!traceActive)
+	{
+		return;
+	}
+	traceActive = false;
+	flushBuffer();
+	{
+		std::lock_guard<std::mutex> lock(writerMutex);
+		stopWriter = true;
+	}
+	writerCondition.notify_one();
+	writerThread.join();
+	std::fclose(traceFile);
+	traceFile = NULL;
+	traceNames.clear();
+}
+
+void traceCall(int native, int id, const std::string &name, int type, int value, int extra)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	traceBuffer.push_back(static_cast<unsigned char>(native));
+	traceBuffer.push_back(static_cast<unsigned char>(type));
+	writeSigned(id);
+	std::pair<boost::unordered_map<std::string, unsigned int>::iterator, bool> n = traceNames.insert(std::make_pair(name, static_cast<unsigned int>(traceNames.size())));
+	writeVarint(n.first->second);
+	if (n.second)
+	{
+		writeVarint(static_cast<unsigned int>(name.length()));
+		traceBuffer.insert(traceBuffer.end(), name.begin(), name.end());
+	}
+	writeSigned(value);
+	writeSigned(extra);
+	writeVarint(static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastCall).count()));
+	lastCall = now;
+	if (traceBuffer.size() >= TRACE_BUFFER_SIZE)
+	{
+		flushBuffer();
+	}
+}
+
+TraceReader::TraceReader(const std::string &path) : file(std::fopen(path.c_str(), "rb")), open(false)
+{
+	unsigned char header[8];
+	if (file && std::fread(header, 1, sizeof(header), file) == sizeof(header))
+	{
+		std::uint32_t magic = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<std::uint32_t>(header[3]) << 24);
+		std::uint32_t version = header[4] | (header[5] << 8) | (header[6] << 16) | (static_cast<std::uint32_t>(header[7]) << 24);
+		open = magic == TRACE_MAGIC && version == TRACE_VERSION;
+	}
+}
+
+TraceReader::~TraceReader()
+{
+	if (file)
+	{
+		std::fclose(file);
+	}
+}
+
+bool TraceReader::valid() const
+{
+	return open;
+}
+
+bool TraceReader::readVarint(unsigned int &value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		int c = std::fgetc(file);
+		if (c == EOF)
+		{
+			return false;
+		}
+		value |= static_cast<unsigned int>(c & 0x7F) << shift;
+		if (!(c & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TraceReader::next(TraceRecord &record)
+{
+	if (!open)
+	{
+		return false;
+	}
+	int native = std::fgetc(file), type = std::fgetc(file);
+	unsigned int id = 0, name = 0, value = 0, extra = 0, delta = 0;
+	if (native == EOF || type == EOF || !readVarint(id) || !readVarint(name))
+	{
+		return false;
+	}
+	if (name == names.size())
+	{
+		unsigned int length = 0;
+		if (!readVarint(length))
+		{
+			return false;
+		}
+		std::string string(length, '\0');
+		if (length && std::fread(&string[0], 1, length, file) != length)
+		{
+			return false;
+		}
+		names.push_back(string);
+	}
+	if (name >= names.size() || !readVarint(value) || !readVarint(extra) || !readVarint(delta))
+	{
+		return false;
+	}
+	record.native = native;
+	record.type = type;
+	record.id = static_cast<int>((id >> 1) ^ (~(id & 1) + 1));
+	record.name = names[name];
+	record.value = static_cast<int>((value >> 1) ^ (~(value & 1) + 1));
+	record.extra = static_cast<int>((extra >> 1) ^ (~(extra & 1) + 1));
+	record.delta = delta;
+	return record.native < TRACE_NATIVES;
+}
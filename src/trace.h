@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "main.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Trace files start with TRACE_MAGIC and TRACE_VERSION (little-endian 32-bit
+// words). Each record is the native (one byte), the value type (one byte),
+// then varints: ID (zigzag), name index, value (zigzag), extra (zigzag) and
+// microseconds since the previous record. A name index equal to the number of
+// names seen so far introduces a new name, followed by its length (varint)
+// and bytes.
+#define TRACE_MAGIC (0x52545647)
+#define TRACE_VERSION (1)
+
+enum TraceNative
+{
+	TRACE_SETGVARINT,
+	TRACE_GETGVARINT,
+	TRACE_SETGVARSTRING,
+	TRACE_GETGVARSTRING,
+	TRACE_GETGVARSTRINGPACKED,
+	TRACE_SETGVARFLOAT,
+	TRACE_GETGVARFLOAT,
+	TRACE_INCREMENTGVARINT,
+	TRACE_DELETEGVAR,
+	TRACE_DELETEGVARS,
+	TRACE_GETGVARSUPPERINDEX,
+	TRACE_GETGVARNAMEATINDEX,
+	TRACE_GETGVARTYPE,
+	TRACE_GETGVARSTRINGLENGTH,
+	TRACE_GETGVARSTRINGSUB,
+	TRACE_COMPAREGVARSTRING,
+	TRACE_APPENDGVARSTRING,
+	TRACE_APPENDGVARSTRINGCAPPED,
+	TRACE_SETGVARINTEX,
+	TRACE_SETGVARSTRINGEX,
+	TRACE_SETGVARFLOATEX,
+	TRACE_SETGVARTTL,
+	TRACE_GETGVARTTL,
+	TRACE_NATIVES
+};
+
+struct TraceRecord
+{
+	int native;
+	int type;
+	int id;
+	std::string name;
+	int value;
+	int extra;
+	unsigned int delta;
+};
+
+extern bool traceActive;
+
+extern const char *traceNativeNames[TRACE_NATIVES];
+
+bool startTrace(const std::string &path);
+void stopTrace();
+void traceCall(int native, int id, const std::string &name, int type, int value, int extra);
+
+class TraceReader
+{
+public:
+	explicit TraceReader(const std::string &path);
+	~TraceReader();
+
+	bool valid() const;
+	bool next(TraceRecord &record);
+private:
+	bool readVarint(unsigned int &value);
+
+	std::FILE *file;
+	std::vector<std::string> names;
+	bool open;
+};
+
+#endif
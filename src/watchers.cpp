@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2014 Incognito
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "watchers.h"
+#include "main.h"
+
+#include <boost/unordered_map.hpp>
+#include <boost/variant.hpp>
+
+#include <sdk/plugin.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Watch
+{
+	int watchId;
+	AMX *amx;
+	int id;
+	std::string callback;
+};
+
+struct Change
+{
+	int id;
+	std::string name;
+	Value value;
+	bool deleted;
+};
+
+typedef std::vector<Watch> WatchList;
+typedef std::pair<int, std::string> ChangeKey;
+
+bool watchersActive = false;
+bool changesPending = false;
+
+static boost::unordered_map<std::string, WatchList> watches;
+static boost::unordered_map<int, std::string> watchNames;
+static int nextWatchId = 1;
+
+// Writes made between two ticks are coalesced per (id, name): the buffer
+// keeps the order in which GVars first changed, and a later write to the
+// same GVar only replaces its value.
+static std::vector<Change> changes;
+static boost::unordered_map<ChangeKey, std::size_t> changePositions;
+
+static void updateHook()
+{
+	watchersActive = !watches.empty();
+	if (watchersActive)
+	{
+		writeHooks |= WRITE_HOOK_WATCH;
+	}
+	else
+	{
+		writeHooks &= ~WRITE_HOOK_WATCH;
+	}
+}
+
+static bool matchesWatch(const Watch &watch, int id)
+{
+	return watch.id == id || watch.id == GLOBAL_VARID_ANY;
+}
+
+int watchGVar(AMX *amx, int id, const std::string &name, const std::string &callback)
+{
+	int index = 0;
+	if (amx_FindPublic(amx, callback.c_str(), &index) != AMX_ERR_NONE)
+	{
+		return 0;
+	}
+	Watch watch = { nextWatchId++, amx, id, callback };
+	watches[name].push_back(watch);
+	watchNames[watch.watchId] = name;
+	updateHook();
+	return watch.watchId;
+}
+
+bool unwatchGVar(AMX *amx, int watchId)
+{
+	boost::unordered_map<int, std::string>::iterator n = watchNames.find(watchId);
+	if (n == watchNames.end())
+	{
+		return false;
+	}
+	boost::unordered_map<std::string, WatchList>::iterator i = watches.find(n->second);
+	for (WatchList::iterator w = i->second.begin(); w != i->second.end(); ++w)
+	{
+		if (w->watchId == watchId)
+		{
+			if (w->amx != amx)
+			{
+				return false;
+			}
+			i->second.erase(w);
+			break;
+		}
+	}
+	if (i->second.empty())
+	{
+		watches.erase(i);
+	}
+	watchNames.erase(n);
+	updateHook();
+	return true;
+}
+
+void recordChange(int id, const std::string &name, const Value *value)
+{
+	boost::unordered_map<std::string, WatchList>::const_iterator i = watches.find(name);
+	if (i == watches.end())
+	{
+		return;
+	}
+	WatchList::const_iterator w = i->second.begin();
+	while (w != i->second.end() && !matchesWatch(*w, id))
+	{
+		++w;
+	}
+	if (w == i->second.end())
+	{
+		return;
+	}
+	std::pair<boost::unordered_map<ChangeKey, std::size_t>::iterator, bool> p = changePositions.insert(std::make_pair(ChangeKey(id, name), changes.size()));
+	if (p.second)
+	{
+		Change change = { id, name, value ? *value : Value(), !value };
+		changes.push_back(change);
+	}
+	else
+	{
+		Change &change = changes[p.first->second];
+		if (value)
+		{
+			change.value = *value;
+		}
+		change.deleted = !value;
+	}
+	changesPending = true;
+}
+
+static void dispatchChange(const Watch &watch, const Change &change)
+{
+	int index = 0;
+	if (amx_FindPublic(watch.amx, watch.callback.c_str(), &index) != AMX_ERR_NONE)
+	{
+		return;
+	}
+	int type = change.deleted ? GLOBAL_VARTYPE_NONE : getType(change.value);
+	cell value = 0;
+	std::string string;
+	if (type == GLOBAL_VARTYPE_INT)
+	{
+		value = static_cast<cell>(boost::get<int>(change.value));
+	}
+	else if (type == GLOBAL_VARTYPE_FLOAT)
+	{
+		float number = boost::get<float>(change.value);
+		value = amx_ftoc(number);
+	}
+	else if (type == GLOBAL_VARTYPE_STRING)
+	{
+		string = boost::get<std::string>(change.value);
+	}
+	cell nameAddress = 0, stringAddress = 0, *physical = NULL;
+	if (amx_Allot(watch.amx, static_cast<int>(string.length()) + 1, &stringAddress, &physical) != AMX_ERR_NONE)
+	{
+		logprintf("*** GVar watch: Not enough heap space in the script to deliver a change of \"%s\"", change.name.c_str());
+		return;
+	}
+	amx_SetString(physical, string.c_str(), 0, 0, static_cast<int>(string.length()) + 1);
+	if (amx_Allot(watch.amx, static_cast<int>(change.name.length()) + 1, &nameAddress, &physical) != AMX_ERR_NONE)
+	{
+		logprintf("*** GVar watch: Not enough heap space in the script to deliver a change of \"%s\"", change.name.c_str());
+		amx_Release(watch.amx, stringAddress);
+		return;
+	}
+	amx_SetString(physical, change.name.c_str(), 0, 0, static_cast<int>(change.name.length()) + 1);
+	amx_Push(watch.amx, stringAddress);
+	amx_Push(watch.amx, value);
+	amx_Push(watch.amx, static_cast<cell>(type));
+	amx_Push(watch.amx, nameAddress);
+	amx_Push(watch.amx, static_cast<cell>(change.id));
+	amx_Push(watch.amx, static_cast<cell>(watch.watchId));
+	amx_Exec(watch.amx, NULL, index);
+	amx_Release(watch.amx, stringAddress);
+}
+
+// Callbacks run once per tick for every GVar that changed. Writes made by a
+// callback are buffered for the next tick, and a watch removed by an earlier
+// callback in the same batch is skipped.
+void processChanges()
+{
+	std::vector<Change> delivered;
+	delivered.swap(changes);
+	changePositions.clear();
+	changesPending = false;
+	for (std::vector<Change>::const_iterator c = delivered.begin(); c != delivered.end(); ++c)
+	{
+		boost::unordered_map<std::string, WatchList>::const_iterator i = watches.find(c->name);
+		if (i == watches.end())
+		{
+			continue;
+		}
+		WatchList matched;
+		for (WatchList::const_iterator w = i->second.begin(); w != i->second.end(); ++w)
+		{
+			if (matchesWatch(*w, c->id))
+			{
+				matched.push_back(*w);
+			}
+		}
+		for (WatchList::const_iterator w = matched.begin(); w != matched.end(); ++w)
+		{
+			if (watchNames.find(w->watchId) != watchNames.end())
+			{
+				dispatchChange(*w, *c);
+			}
+		}
+	}
+}
+
+void releaseWatches(AMX *amx)
+{
+	for (boost::unordered_map<std::string, WatchList>::iterator i = watches.begin(); i != watches.end(); )
+	{
+		for (WatchList::iterator w = i->second.begin(); w != i->second.end(); )
+		{
+			if (w->amx == amx)
+			{
+				watchNames.erase(w->watchId);
+				w = i->second.erase(w);
+			}
+			else
+			{
+				++w;
+			}
+		}
+		if (i->second.empty())
+		{
+			i = watches.erase(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+	updateHook();
+}